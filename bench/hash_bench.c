@@ -0,0 +1,113 @@
+/*
+ * Microbenchmark for the window lookup index: average cost of a lookup as
+ * the number of managed windows grows, compared with the linear scan it
+ * replaced. Every window contributes two keys (client and frame id), laid
+ * out the way the X server hands them out. In the "two" workload all
+ * clients come from two id bases; in "spread" every window is the first
+ * toplevel of its own client, so the ids differ only in the resource base
+ * bits (client << 21) and share the same small offset.
+ */
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "hash.h"
+
+#define LOOKUPS (1u << 22)
+
+typedef struct {
+	uint32_t	frame;
+	uint32_t	id;
+} bench_window_t;
+
+static double
+now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int32_t
+linear_find(const bench_window_t *windows, const uint32_t len, const uint32_t key)
+{
+	for (uint32_t i = 0; i < len; ++i)
+	{
+		if (windows[i].id == key || windows[i].frame == key)
+		{
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+int
+main(void)
+{
+	uint32_t *keys = malloc(LOOKUPS * sizeof(uint32_t));
+	volatile int64_t sink = 0;
+
+	printf("%8s %8s %12s %12s\n", "workload", "windows", "hash_ns", "linear_ns");
+
+	for (uint32_t spread = 0; spread < 2; ++spread)
+	{
+		for (uint32_t n = 16; n <= 16384; n *= 4)
+		{
+			// Client bases beyond that no longer fit the 32-bit id
+			if (spread && n > 1024)
+			{
+				continue;
+			}
+
+			bench_window_t *windows = malloc(n * sizeof(bench_window_t));
+			wm_hash_t hash;
+
+			hash_init(&hash, 0);
+			srand(n);
+
+			for (uint32_t i = 0; i < n; ++i)
+			{
+				windows[i].frame = 0x00200000 + i * 2 + 1;
+				windows[i].id = (spread) ? ((i + 8) << 21) | 0x0a : 0x00c00000 + i * 7 + 1;
+				hash_insert(&hash, windows[i].frame, i);
+				hash_insert(&hash, windows[i].id, i);
+			}
+
+			for (uint32_t i = 0; i < LOOKUPS; ++i)
+			{
+				const bench_window_t *w = &windows[rand() % n];
+				keys[i] = (i & 1) ? w->frame : w->id;
+			}
+
+			double start = now();
+			for (uint32_t i = 0; i < LOOKUPS; ++i)
+			{
+				sink += hash_find(&hash, keys[i]);
+			}
+			const double hash_ns = (now() - start) / LOOKUPS;
+
+			// The scan gets too slow to run the full key set at large n
+			const uint32_t scans = (LOOKUPS / n > 1024) ? LOOKUPS / n : 1024;
+			start = now();
+			for (uint32_t i = 0; i < scans; ++i)
+			{
+				sink += linear_find(windows, n, keys[i]);
+			}
+			const double linear_ns = (now() - start) / scans;
+
+			printf("%8s %8u %12.2f %12.2f\n", (spread) ? "spread" : "two",
+					n, hash_ns, linear_ns);
+
+			hash_free(&hash);
+			free(windows);
+		}
+	}
+
+	free(keys);
+
+	return 0;
+}
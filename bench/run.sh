@@ -0,0 +1,88 @@
+#!/bin/sh
+#
+# Headless end-to-end benchmarks: start Xvfb, run martwm against it and
+# drive it with bench/xbench. Prints JSON lines on stdout, one header line
+# followed by one line per workload. Extra arguments go to xbench.
+#
+
+WM=${WM:-./martwm}
+XBENCH=${XBENCH:-bench/xbench}
+BENCH_DISPLAY=${BENCH_DISPLAY:-:99}
+
+if ! command -v Xvfb >/dev/null 2>&1
+then
+	echo "bench: Xvfb not found, skipping end-to-end benchmarks" >&2
+	exit 0
+fi
+
+Xvfb "${BENCH_DISPLAY}" -screen 0 1280x1024x24 -nolisten tcp >/dev/null 2>&1 &
+xvfb=$!
+wm=
+
+cleanup() {
+	[ -n "${wm}" ] && kill "${wm}" 2>/dev/null
+	kill "${xvfb}" 2>/dev/null
+}
+trap cleanup EXIT INT TERM
+
+# Wait for the server socket to appear
+socket="/tmp/.X11-unix/X${BENCH_DISPLAY#:}"
+tries=0
+while [ ! -S "${socket}" ]
+do
+	tries=$((tries + 1))
+	if [ "${tries}" -gt 50 ]
+	then
+		echo "bench: Xvfb did not start on ${BENCH_DISPLAY}" >&2
+		exit 1
+	fi
+	sleep 0.1
+done
+
+# Startup time with fonts loaded in the background and, for comparison,
+# before the loop starts (MARTWM_SYNC_FONTS)
+startup() {
+	log=$(mktemp)
+	env DISPLAY="${BENCH_DISPLAY}" "$@" "${WM}" >"${log}" 2>/dev/null &
+	wm=$!
+
+	tries=0
+	while ! grep -q '^Fonts ready' "${log}" && [ "${tries}" -lt 100 ]
+	do
+		tries=$((tries + 1))
+		sleep 0.05
+	done
+
+	kill "${wm}" 2>/dev/null
+	wait "${wm}" 2>/dev/null
+	wm=
+
+	ready=$(sed -n 's/^Ready in \([0-9]*\) ms.*/\1/p' "${log}")
+	fonts=$(sed -n 's/^Fonts ready in \([0-9]*\) ms.*/\1/p' "${log}")
+	rm -f "${log}"
+}
+
+DISPLAY="${BENCH_DISPLAY}" MARTWM_STATS=1 "${WM}" >/dev/null &
+wm=$!
+
+printf '{"version":"%s","display":"%s","wm_pid":%s}\n' \
+	"${VERSION:-unknown}" "${BENCH_DISPLAY}" "${wm}"
+
+DISPLAY="${BENCH_DISPLAY}" "${XBENCH}" -p "${wm}" "$@"
+status=$?
+
+# Leave the WM's own counters on stderr for digging into regressions
+kill -USR1 "${wm}" 2>/dev/null
+sleep 0.1
+kill "${wm}" 2>/dev/null
+wait "${wm}" 2>/dev/null
+wm=
+
+startup
+printf '{"workload":"startup","fonts":"background","ready_ms":%s,"fonts_ms":%s}\n' \
+	"${ready:-null}" "${fonts:-null}"
+
+startup MARTWM_SYNC_FONTS=1
+printf '{"workload":"startup","fonts":"sync","ready_ms":%s}\n' "${ready:-null}"
+
+exit ${status}
@@ -0,0 +1,187 @@
+/*
+ * Microbenchmark for edge snapping: cost of finding the snap for one
+ * motion event of a window drag as the number of windows grows, against
+ * checking every window's edges, plus the cost of re-indexing the window
+ * when it is dropped. Windows are either scattered over a 3840x2160
+ * desktop or stacked in 8 aligned columns, where every column line holds
+ * the edges of a whole column of windows and a short window dragged along
+ * the lines only overlaps a few of them.
+ */
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "snap.h"
+
+#define MOTIONS (1u << 20)
+#define DISTANCE 12
+
+static double
+now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int32_t
+nearest(int32_t best, const int32_t delta)
+{
+	return (abs(delta) <= DISTANCE && abs(delta) < abs(best)) ? delta : best;
+}
+
+/*
+ * What mouse_motion would do without an index: every side of every
+ * window, checked against both sides of the moving one.
+ */
+static void
+linear_snap(const xcb_rectangle_t *rects, const uint32_t len, xcb_rectangle_t *rect)
+{
+	int32_t dx = DISTANCE + 1;
+	int32_t dy = DISTANCE + 1;
+
+	for (uint32_t i = 0; i < len; ++i)
+	{
+		const xcb_rectangle_t *r = &rects[i];
+
+		if (r->y < rect->y + rect->height && r->y + r->height > rect->y)
+		{
+			dx = nearest(dx, r->x - rect->x);
+			dx = nearest(dx, r->x + r->width - rect->x);
+			dx = nearest(dx, r->x - (rect->x + rect->width));
+			dx = nearest(dx, r->x + r->width - (rect->x + rect->width));
+		}
+
+		if (r->x < rect->x + rect->width && r->x + r->width > rect->x)
+		{
+			dy = nearest(dy, r->y - rect->y);
+			dy = nearest(dy, r->y + r->height - rect->y);
+			dy = nearest(dy, r->y - (rect->y + rect->height));
+			dy = nearest(dy, r->y + r->height - (rect->y + rect->height));
+		}
+	}
+
+	rect->x += (abs(dx) <= DISTANCE) ? dx : 0;
+	rect->y += (abs(dy) <= DISTANCE) ? dy : 0;
+}
+
+static xcb_rectangle_t
+scattered_window(const uint32_t i, const uint32_t n)
+{
+	(void) i;
+	(void) n;
+
+	return (xcb_rectangle_t) {
+		.x = rand() % 3200,
+		.y = rand() % 1700,
+		.width = 200 + rand() % 600,
+		.height = 150 + rand() % 400
+	};
+}
+
+static xcb_rectangle_t
+scattered_drag(const uint32_t i)
+{
+	return (xcb_rectangle_t) { i % 3200, (i / 3200) % 1700, 640, 480 };
+}
+
+static xcb_rectangle_t
+aligned_window(const uint32_t i, const uint32_t n)
+{
+	const uint32_t rows = n / 8;
+	const uint16_t height = (2160 / rows > 0) ? 2160 / rows : 1;
+
+	return (xcb_rectangle_t) {
+		.x = (i / rows) * 480,
+		.y = (i % rows) * height,
+		.width = 480,
+		.height = height
+	};
+}
+
+/*
+ * Along the column lines, where every motion has edges within reach
+ */
+static xcb_rectangle_t
+aligned_drag(const uint32_t i)
+{
+	return (xcb_rectangle_t) { (i % 8) * 480 + (i / 8) % 32 - 16, (i / 256) % 2160, 320, 24 };
+}
+
+static const struct {
+	const char	*name;
+	xcb_rectangle_t	(*window)(const uint32_t i, const uint32_t n);
+	xcb_rectangle_t	(*drag)(const uint32_t i);
+} layouts[] = {
+	{ "scattered", scattered_window, scattered_drag },
+	{ "aligned", aligned_window, aligned_drag },
+};
+
+int
+main(void)
+{
+	volatile int64_t sink = 0;
+
+	printf("%10s %8s %12s %12s %12s\n", "layout", "windows", "snap_ns", "linear_ns", "reindex_ns");
+
+	for (uint32_t l = 0; l < sizeof(layouts) / sizeof(layouts[0]); ++l)
+	{
+		for (uint32_t n = 16; n <= 4096; n *= 4)
+		{
+			xcb_rectangle_t *rects = malloc(n * sizeof(xcb_rectangle_t));
+			wm_snap_t snap;
+
+			snap_init(&snap, n);
+			srand(n);
+
+			for (uint32_t i = 0; i < n; ++i)
+			{
+				rects[i] = layouts[l].window(i, n);
+				snap_add(&snap, i + 1, &rects[i]);
+			}
+
+			// A drag sweeping the desktop one motion event at a time
+			double start = now();
+			for (uint32_t i = 0; i < MOTIONS; ++i)
+			{
+				xcb_rectangle_t rect = layouts[l].drag(i);
+				snap_find(&snap, 0, &rect, DISTANCE);
+				sink += rect.x + rect.y;
+			}
+			const double snap_ns = (now() - start) / MOTIONS;
+
+			const uint32_t scans = (MOTIONS / n > 4096) ? MOTIONS / n : 4096;
+			start = now();
+			for (uint32_t i = 0; i < scans; ++i)
+			{
+				xcb_rectangle_t rect = layouts[l].drag(i);
+				linear_snap(rects, n, &rect);
+				sink += rect.x + rect.y;
+			}
+			const double linear_ns = (now() - start) / scans;
+
+			// Dropping a window moves its four edges in the index
+			const uint32_t moves = 65536;
+			start = now();
+			for (uint32_t i = 0; i < moves; ++i)
+			{
+				xcb_rectangle_t *rect = &rects[i % n];
+
+				snap_remove(&snap, i % n + 1, rect);
+				rect->x = (rect->x + 37) % 3200;
+				snap_add(&snap, i % n + 1, rect);
+			}
+			const double reindex_ns = (now() - start) / moves;
+
+			printf("%10s %8u %12.2f %12.2f %12.2f\n", layouts[l].name, n, snap_ns, linear_ns, reindex_ns);
+
+			snap_free(&snap);
+			free(rects);
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,128 @@
+/*
+ * Lifecycle stress test for the window table: map and unmap 100k windows
+ * in bursts, as tooltips, dialogs and dmenu do, and check that slots are
+ * recycled, the lookup index stays in step with the table, and handles to
+ * removed windows never resolve again.
+ */
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "window.h"
+
+#define WINDOWS 100000
+#define MAX_LIVE 64
+
+static double
+now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int
+main(void)
+{
+	wm_table_t table;
+	int32_t live[MAX_LIVE];
+	wm_handle_t stale[MAX_LIVE];
+	uint32_t live_len = 0;
+	uint32_t stale_len = 0;
+	uint32_t peak = 0;
+	xcb_window_t next_id = 0x00c00001;
+	xcb_window_t next_frame = 0x00200001;
+
+	if (!table_init(&table, 64))
+	{
+		return 1;
+	}
+
+	srand(1);
+
+	const double start = now();
+
+	for (uint32_t mapped = 0; mapped < WINDOWS;)
+	{
+		// Map a burst, then unmap a random subset of what is live
+		const uint32_t burst = (live_len < MAX_LIVE) ?
+			1 + rand() % (MAX_LIVE - live_len) : 0;
+
+		for (uint32_t i = 0; i < burst && mapped < WINDOWS; ++i, ++mapped)
+		{
+			const int32_t index = table_add(&table, next_id++, next_frame++);
+			if (index == -1)
+			{
+				fprintf(stderr, "FAIL: table_add\n");
+				return 1;
+			}
+
+			live[live_len++] = index;
+		}
+
+		peak = (live_len > peak) ? live_len : peak;
+
+		const uint32_t unmap = rand() % (live_len + 1);
+		stale_len = 0;
+
+		for (uint32_t i = 0; i < unmap; ++i)
+		{
+			const uint32_t pick = rand() % live_len;
+			const int32_t index = live[pick];
+			const xcb_window_t id = table.windows[index].id;
+
+			stale[stale_len++] = table_handle(&table, index);
+			table_remove(&table, index);
+			live[pick] = live[--live_len];
+
+			if (table_find(&table, id) != -1)
+			{
+				fprintf(stderr, "FAIL: removed id %u still found\n", id);
+				return 1;
+			}
+		}
+
+		for (uint32_t i = 0; i < stale_len; ++i)
+		{
+			if (table_resolve(&table, stale[i]) != -1)
+			{
+				fprintf(stderr, "FAIL: stale handle resolved\n");
+				return 1;
+			}
+		}
+
+		for (uint32_t i = 0; i < live_len; ++i)
+		{
+			const wm_window_t *window = &table.windows[live[i]];
+
+			if (table_find(&table, window->id) != live[i] ||
+					table_find_frame(&table, window->frame) != live[i])
+			{
+				fprintf(stderr, "FAIL: live window lost\n");
+				return 1;
+			}
+		}
+	}
+
+	const double elapsed = now() - start;
+
+	if (table.count != live_len || table.index.len != live_len * 2 ||
+			table.len > peak)
+	{
+		fprintf(stderr, "FAIL: table grew past its peak (len %u, peak %u)\n",
+				table.len, peak);
+		return 1;
+	}
+
+	printf("%u windows, peak %u live, %u slots, %u index buckets, "
+			"%.1f ns per map/unmap\n",
+			WINDOWS, peak, table.len, table.index.cap,
+			elapsed / WINDOWS);
+
+	table_free(&table);
+
+	return 0;
+}
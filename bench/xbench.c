@@ -0,0 +1,659 @@
+/*
+ * End-to-end workload driver for martwm. Connects to the display martwm
+ * is managing (normally a headless Xvfb started by bench/run.sh), plays
+ * scripted workloads as an ordinary client and prints one JSON object
+ * per workload on stdout.
+ *
+ * usage: xbench [-p wm_pid] [-n windows] [-e events] [workload...]
+ * workloads: map drag title focus (all by default)
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <xcb/xcb.h>
+#include <xcb/xcbext.h>
+
+typedef struct {
+	const char	*name;
+	uint32_t	count;
+	double		elapsed_us;
+	double		wm_cpu_ms;
+	double		*latency;
+	uint32_t	latency_len;
+
+	// Server resources held by the WM around the workload, -1 if unknown
+	int64_t		resources_before;
+	int64_t		resources_after;
+} bench_result_t;
+
+static xcb_connection_t	*connection = NULL;
+static xcb_screen_t	*screen = NULL;
+static long		wm_pid = 0;
+static uint32_t		windows_n = 200;
+static uint32_t		events_n = 10000;
+
+// A frame of the WM's, to name it to X-Resource, and the window inside it
+static xcb_window_t	wm_xid = 0;
+static xcb_window_t	probe = 0;
+
+static double
+now_us(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+// User plus system CPU time of the WM, from /proc/<pid>/stat
+static double
+wm_cpu_ms(void)
+{
+	char path[64];
+	char buf[1024];
+	unsigned long utime = 0;
+	unsigned long stime = 0;
+
+	if (wm_pid <= 0)
+	{
+		return 0.0;
+	}
+
+	snprintf(path, sizeof(path), "/proc/%ld/stat", wm_pid);
+	FILE *file = fopen(path, "r");
+	if (!file)
+	{
+		return 0.0;
+	}
+
+	const size_t len = fread(buf, 1, sizeof(buf) - 1, file);
+	fclose(file);
+	buf[len] = '\0';
+
+	// Skip "pid (comm) state", comm may contain spaces
+	const char *p = strrchr(buf, ')');
+	if (!p || sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu",
+				&utime, &stime) != 2)
+	{
+		return 0.0;
+	}
+
+	return (utime + stime) * 1000.0 / sysconf(_SC_CLK_TCK);
+}
+
+static xcb_window_t
+window_create(const int16_t x, const int16_t y)
+{
+	xcb_window_t window = xcb_generate_id(connection);
+
+	xcb_create_window(connection, XCB_COPY_FROM_PARENT,
+			window, screen->root,
+			x, y, 100, 100, 0,
+			XCB_WINDOW_CLASS_INPUT_OUTPUT,
+			screen->root_visual,
+			XCB_CW_BACK_PIXEL | XCB_CW_EVENT_MASK,
+			(uint32_t []) {
+				screen->white_pixel,
+				XCB_EVENT_MASK_STRUCTURE_NOTIFY
+			});
+
+	return window;
+}
+
+// Wait for an event of type on window, dropping everything else
+static void
+wait_for(const uint8_t type, const xcb_window_t window)
+{
+	xcb_generic_event_t *ev;
+
+	xcb_flush(connection);
+
+	while ((ev = xcb_wait_for_event(connection)))
+	{
+		const uint8_t ev_type = ev->response_type & ~0x80;
+		xcb_window_t ev_window = 0;
+
+		if (ev_type == XCB_MAP_NOTIFY)
+		{
+			ev_window = ((xcb_map_notify_event_t *) ev)->window;
+		}
+		else if (ev_type == XCB_CONFIGURE_NOTIFY)
+		{
+			ev_window = ((xcb_configure_notify_event_t *) ev)->window;
+		}
+
+		free(ev);
+
+		if (ev_type == type && ev_window == window)
+		{
+			return;
+		}
+	}
+
+	fprintf(stderr, "xbench: lost connection to the X server\n");
+	exit(1);
+}
+
+/*
+ * martwm handles events in order, so once a window mapped after a
+ * workload is visible, everything sent before it has been processed.
+ */
+static void
+fence(void)
+{
+	xcb_window_t window = window_create(0, 0);
+
+	xcb_map_window(connection, window);
+	wait_for(XCB_MAP_NOTIFY, window);
+	xcb_destroy_window(connection, window);
+	xcb_flush(connection);
+}
+
+static xcb_window_t
+frame_of(const xcb_window_t window)
+{
+	xcb_query_tree_reply_t *reply = xcb_query_tree_reply(connection,
+			xcb_query_tree(connection, window), NULL);
+	xcb_window_t parent = 0;
+
+	if (reply)
+	{
+		parent = reply->parent;
+		free(reply);
+	}
+
+	return parent;
+}
+
+// Synthetic events are sent to whoever selected the mask on destination
+static void
+send_to(const xcb_window_t destination, const uint32_t mask, const void *event)
+{
+	xcb_send_event(connection, 0, destination, mask, (const char *) event);
+}
+
+static void
+send_button(const uint8_t type, const xcb_window_t child, const int16_t x, const int16_t y)
+{
+	xcb_button_press_event_t event = {
+		.response_type = type,
+		.detail = 1,
+		.root = screen->root,
+		.event = screen->root,
+		.child = child,
+		.root_x = x,
+		.root_y = y,
+		.state = XCB_MOD_MASK_4,
+		.same_screen = 1
+	};
+
+	send_to(screen->root, XCB_EVENT_MASK_BUTTON_PRESS, &event);
+}
+
+/*
+ * Total number of server resources (windows, pixmaps, GCs, alarms, ...)
+ * held by the client that owns xid, through X-Resource
+ * QueryClientResources. The request is built by hand so xbench keeps
+ * depending on libxcb alone. Returns -1 without the extension.
+ */
+static int64_t
+client_resources(const xcb_window_t xid)
+{
+	static xcb_extension_t res = { "X-Resource", 0 };
+	const xcb_query_extension_reply_t *ext = xcb_get_extension_data(connection, &res);
+
+	if (!ext || !ext->present)
+	{
+		return -1;
+	}
+
+	struct {
+		uint8_t		major;
+		uint8_t		minor;
+		uint16_t	length;
+		uint32_t	xid;
+	} request = { .xid = xid };
+	struct iovec parts[4] = { [2] = { &request, sizeof(request) } };
+	const xcb_protocol_request_t info = {
+		.count = 2,
+		.ext = &res,
+		.opcode = 2,	// QueryClientResources
+		.isvoid = 0
+	};
+
+	const unsigned int sequence = xcb_send_request(connection, 0, parts + 2, &info);
+	uint8_t *reply = xcb_wait_for_reply(connection, sequence, NULL);
+
+	if (!reply)
+	{
+		return -1;
+	}
+
+	// Header of 32 bytes with the type count at 8, then (atom, count) pairs
+	const uint32_t types = *(uint32_t *) (reply + 8);
+	const uint32_t *pairs = (uint32_t *) (reply + 32);
+	int64_t total = 0;
+
+	for (uint32_t i = 0; i < types; ++i)
+	{
+		total += pairs[i * 2 + 1];
+	}
+
+	free(reply);
+
+	return total;
+}
+
+/*
+ * Resources of the WM once it has caught up with everything sent before.
+ * Releases may still be queued after a fence, so poll every 10 ms for up
+ * to a second until the count reaches target, or with a negative target
+ * until two reads agree.
+ */
+static int64_t
+client_resources_settled(const xcb_window_t xid, const int64_t target)
+{
+	int64_t count = client_resources(xid);
+
+	for (uint32_t i = 0; i < 100 && count != -1; ++i)
+	{
+		const int64_t last = count;
+
+		if (count == target)
+		{
+			break;
+		}
+
+		nanosleep(&(struct timespec) { .tv_nsec = 10000000 }, NULL);
+		count = client_resources(xid);
+
+		if (target < 0 && count == last)
+		{
+			break;
+		}
+	}
+
+	return count;
+}
+
+static xcb_window_t
+wm_check_window(const xcb_window_t window, const xcb_atom_t check)
+{
+	xcb_get_property_reply_t *reply = xcb_get_property_reply(connection,
+			xcb_get_property(connection, 0, window, check, XCB_ATOM_WINDOW, 0, 1), NULL);
+	xcb_window_t found = 0;
+
+	if (reply && xcb_get_property_value_length(reply) == sizeof(xcb_window_t))
+	{
+		found = *(xcb_window_t *) xcb_get_property_value(reply);
+	}
+
+	free(reply);
+
+	return found;
+}
+
+/*
+ * Wait up to 5 s for a WM to announce itself: _NET_SUPPORTING_WM_CHECK on
+ * the root window naming a window that names itself. martwm sets it after
+ * taking over the root, so a probe window mapped then is managed; the
+ * probe stays mapped for the whole run and its frame names the WM to
+ * X-Resource. Without this the first workload could time the bare server.
+ */
+static bool
+wm_wait(void)
+{
+	xcb_intern_atom_reply_t *atom = xcb_intern_atom_reply(connection,
+			xcb_intern_atom(connection, 0, 24, "_NET_SUPPORTING_WM_CHECK"), NULL);
+	bool ready = false;
+
+	if (!atom)
+	{
+		return false;
+	}
+
+	for (uint32_t i = 0; i < 500 && !ready; ++i)
+	{
+		const xcb_window_t check = wm_check_window(screen->root, atom->atom);
+
+		ready = check && wm_check_window(check, atom->atom) == check;
+
+		if (!ready)
+		{
+			nanosleep(&(struct timespec) { .tv_nsec = 10000000 }, NULL);
+		}
+	}
+
+	free(atom);
+
+	if (!ready)
+	{
+		return false;
+	}
+
+	probe = window_create(0, 0);
+	xcb_map_window(connection, probe);
+	wait_for(XCB_MAP_NOTIFY, probe);
+
+	wm_xid = frame_of(probe);
+
+	return wm_xid && wm_xid != screen->root;
+}
+
+static void
+result_begin(bench_result_t *result, const char *name, const uint32_t count)
+{
+	memset(result, 0, sizeof(bench_result_t));
+	result->resources_before = result->resources_after = -1;
+	result->name = name;
+	result->count = count;
+	result->wm_cpu_ms = wm_cpu_ms();
+	result->elapsed_us = now_us();
+}
+
+static void
+result_end(bench_result_t *result)
+{
+	fence();
+	result->elapsed_us = now_us() - result->elapsed_us;
+	result->wm_cpu_ms = wm_cpu_ms() - result->wm_cpu_ms;
+}
+
+static int
+compare_double(const void *a, const void *b)
+{
+	const double x = *(const double *) a;
+	const double y = *(const double *) b;
+
+	return (x > y) - (x < y);
+}
+
+static void
+result_print(bench_result_t *result)
+{
+	printf("{\"workload\":\"%s\",\"count\":%u,\"elapsed_ms\":%.3f,"
+			"\"events_per_sec\":%.1f,\"wm_cpu_ms\":%.1f",
+			result->name, result->count,
+			result->elapsed_us / 1000.0,
+			result->count / (result->elapsed_us / 1e6),
+			result->wm_cpu_ms);
+
+	if (result->latency_len)
+	{
+		double sum = 0.0;
+
+		qsort(result->latency, result->latency_len, sizeof(double), compare_double);
+
+		for (uint32_t i = 0; i < result->latency_len; ++i)
+		{
+			sum += result->latency[i];
+		}
+
+		printf(",\"map_latency_us\":{\"mean\":%.1f,\"p50\":%.1f,\"p99\":%.1f,\"max\":%.1f}",
+				sum / result->latency_len,
+				result->latency[result->latency_len / 2],
+				result->latency[result->latency_len * 99 / 100],
+				result->latency[result->latency_len - 1]);
+	}
+
+	if (result->resources_before != -1)
+	{
+		printf(",\"wm_resources\":{\"before\":%lld,\"after\":%lld}",
+				(long long) result->resources_before,
+				(long long) result->resources_after);
+	}
+
+	printf("}\n");
+	fflush(stdout);
+	free(result->latency);
+}
+
+static xcb_window_t *
+windows_map(const uint32_t n, double *latency)
+{
+	xcb_window_t *windows = malloc(n * sizeof(xcb_window_t));
+
+	for (uint32_t i = 0; i < n; ++i)
+	{
+		windows[i] = window_create((i * 37) % 800, (i * 23) % 600);
+
+		const double start = now_us();
+		xcb_map_window(connection, windows[i]);
+		wait_for(XCB_MAP_NOTIFY, windows[i]);
+
+		if (latency)
+		{
+			latency[i] = now_us() - start;
+		}
+	}
+
+	return windows;
+}
+
+static void
+windows_destroy(xcb_window_t *windows, const uint32_t n)
+{
+	for (uint32_t i = 0; i < n; ++i)
+	{
+		xcb_destroy_window(connection, windows[i]);
+	}
+
+	free(windows);
+	fence();
+}
+
+/*
+ * Map and unmap windows one after the other, timing each map. Once every
+ * window is gone the WM should hold exactly the server resources it held
+ * before, frames, decoration pixmaps and alarms included.
+ */
+static void
+bench_map(void)
+{
+	bench_result_t result;
+
+	fence();
+	const int64_t before = client_resources_settled(wm_xid, -1);
+
+	result_begin(&result, "map_unmap", windows_n * 2);
+	result.latency = malloc(windows_n * sizeof(double));
+	result.latency_len = windows_n;
+
+	xcb_window_t *windows = windows_map(windows_n, result.latency);
+
+	for (uint32_t i = 0; i < windows_n; ++i)
+	{
+		xcb_unmap_window(connection, windows[i]);
+		xcb_destroy_window(connection, windows[i]);
+	}
+
+	free(windows);
+	result_end(&result);
+
+	result.resources_before = before;
+	result.resources_after = client_resources_settled(wm_xid, before);
+
+	if (result.resources_after != result.resources_before)
+	{
+		fprintf(stderr, "xbench: the WM holds %lld server resources after map_unmap, %lld before\n",
+				(long long) result.resources_after, (long long) result.resources_before);
+	}
+
+	result_print(&result);
+}
+
+// Mod4-Button1 drag with a storm of motion events
+static void
+bench_drag(void)
+{
+	bench_result_t result;
+	xcb_window_t *windows = windows_map(1, NULL);
+	const xcb_window_t frame = frame_of(windows[0]);
+
+	xcb_change_window_attributes(connection, frame,
+			XCB_CW_EVENT_MASK,
+			(uint32_t []) { XCB_EVENT_MASK_STRUCTURE_NOTIFY });
+	fence();
+
+	result_begin(&result, "drag_storm", events_n);
+
+	send_button(XCB_BUTTON_PRESS, frame, 10, 10);
+
+	for (uint32_t i = 0; i < events_n; ++i)
+	{
+		xcb_motion_notify_event_t event = {
+			.response_type = XCB_MOTION_NOTIFY,
+			.root = screen->root,
+			.event = screen->root,
+			.root_x = 10 + i % 300,
+			.root_y = 10 + (i / 3) % 200,
+			.state = XCB_MOD_MASK_4 | XCB_BUTTON_MASK_1,
+			.same_screen = 1
+		};
+
+		send_to(screen->root, XCB_EVENT_MASK_BUTTON_PRESS, &event);
+	}
+
+	send_button(XCB_BUTTON_RELEASE, frame, 10, 10);
+	result_end(&result);
+	result_print(&result);
+
+	windows_destroy(windows, 1);
+}
+
+// Rapid WM_NAME changes on the focused window
+static void
+bench_title(void)
+{
+	bench_result_t result;
+	xcb_window_t *windows = windows_map(1, NULL);
+	char name[32];
+
+	result_begin(&result, "title_storm", events_n);
+
+	for (uint32_t i = 0; i < events_n; ++i)
+	{
+		const int len = snprintf(name, sizeof(name), "title %u", i % 64);
+
+		xcb_change_property(connection, XCB_PROP_MODE_REPLACE,
+				windows[0], XCB_ATOM_WM_NAME, XCB_ATOM_STRING,
+				8, len, name);
+	}
+
+	result_end(&result);
+	result_print(&result);
+
+	windows_destroy(windows, 1);
+}
+
+// Sweep focus across every window by sending EnterNotify to each frame
+static void
+bench_focus(void)
+{
+	bench_result_t result;
+	const uint32_t n = (windows_n < 50) ? windows_n : 50;
+	xcb_window_t *windows = windows_map(n, NULL);
+	xcb_window_t *frames = malloc(n * sizeof(xcb_window_t));
+
+	for (uint32_t i = 0; i < n; ++i)
+	{
+		frames[i] = frame_of(windows[i]);
+	}
+
+	result_begin(&result, "focus_sweep", events_n);
+
+	for (uint32_t i = 0; i < events_n; ++i)
+	{
+		xcb_enter_notify_event_t event = {
+			.response_type = XCB_ENTER_NOTIFY,
+			.root = screen->root,
+			.event = frames[i % n],
+			.mode = XCB_NOTIFY_MODE_NORMAL,
+			.detail = XCB_NOTIFY_DETAIL_ANCESTOR,
+			.same_screen_focus = 1
+		};
+
+		send_to(frames[i % n], XCB_EVENT_MASK_ENTER_WINDOW, &event);
+	}
+
+	result_end(&result);
+	result_print(&result);
+
+	free(frames);
+	windows_destroy(windows, n);
+}
+
+int
+main(int argc, char **argv)
+{
+	int first = 1;
+
+	for (; first < argc && argv[first][0] == '-'; first += 2)
+	{
+		if (first + 1 >= argc)
+		{
+			fprintf(stderr, "usage: xbench [-p wm_pid] [-n windows] [-e events] [workload...]\n");
+			return 1;
+		}
+
+		switch (argv[first][1])
+		{
+		case 'p': wm_pid = strtol(argv[first + 1], NULL, 10); break;
+		case 'n': windows_n = strtoul(argv[first + 1], NULL, 10); break;
+		case 'e': events_n = strtoul(argv[first + 1], NULL, 10); break;
+		}
+	}
+
+	connection = xcb_connect(NULL, NULL);
+	if (xcb_connection_has_error(connection))
+	{
+		fprintf(stderr, "xbench: cannot connect to the X server\n");
+		return 1;
+	}
+
+	screen = xcb_setup_roots_iterator(xcb_get_setup(connection)).data;
+
+	// Make sure the WM is up and managing before timing anything
+	if (!wm_wait())
+	{
+		fprintf(stderr, "xbench: no window manager is managing windows\n");
+		xcb_disconnect(connection);
+		return 1;
+	}
+
+	static const struct {
+		const char	*name;
+		void		(*run)(void);
+	} workloads[] = {
+		{ "map", bench_map },
+		{ "drag", bench_drag },
+		{ "title", bench_title },
+		{ "focus", bench_focus }
+	};
+
+	for (uint32_t i = 0; i < sizeof(workloads) / sizeof(workloads[0]); ++i)
+	{
+		int selected = (first == argc);
+
+		for (int j = first; j < argc; ++j)
+		{
+			selected |= strcmp(argv[j], workloads[i].name) == 0;
+		}
+
+		if (selected)
+		{
+			workloads[i].run();
+		}
+	}
+
+	xcb_destroy_window(connection, probe);
+	xcb_disconnect(connection);
+
+	return 0;
+}
@@ -0,0 +1,82 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "ewmh.h"
+
+bool
+ewmh_list_init(wm_ewmh_list_t *list, const uint32_t cap)
+{
+	list->windows = malloc(cap * sizeof(xcb_window_t));
+	list->len = 0;
+	list->cap = (list->windows) ? cap : 0;
+
+	return list->windows != NULL;
+}
+
+void
+ewmh_list_free(wm_ewmh_list_t *list)
+{
+	free(list->windows);
+	list->windows = NULL;
+	list->len = list->cap = 0;
+}
+
+bool
+ewmh_list_append(wm_ewmh_list_t *list, const xcb_window_t window)
+{
+	if (list->len == list->cap)
+	{
+		const uint32_t cap = (list->cap) ? list->cap * 2 : 16;
+		xcb_window_t *windows = realloc(list->windows, cap * sizeof(xcb_window_t));
+
+		if (!windows)
+		{
+			return false;
+		}
+
+		list->windows = windows;
+		list->cap = cap;
+	}
+
+	list->windows[list->len++] = window;
+
+	return true;
+}
+
+/*
+ * Returns whether the window was listed.
+ */
+bool
+ewmh_list_remove(wm_ewmh_list_t *list, const xcb_window_t window)
+{
+	for (uint32_t i = 0; i < list->len; ++i)
+	{
+		if (list->windows[i] == window)
+		{
+			memmove(&list->windows[i], &list->windows[i + 1],
+					(list->len - i - 1) * sizeof(xcb_window_t));
+			--list->len;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/*
+ * Move a window to the end of the list. Returns false if it was already
+ * there or is not listed, when the property does not change.
+ */
+bool
+ewmh_list_raise(wm_ewmh_list_t *list, const xcb_window_t window)
+{
+	if (list->len == 0 || list->windows[list->len - 1] == window ||
+			!ewmh_list_remove(list, window))
+	{
+		return false;
+	}
+
+	list->windows[list->len++] = window;
+
+	return true;
+}
@@ -0,0 +1,28 @@
+#ifndef MARTWM_EWMH_H
+#define MARTWM_EWMH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <xcb/xcb.h>
+
+/*
+ * The WM's copy of a root window list property such as _NET_CLIENT_LIST.
+ * Additions at the end only need a PropModeAppend of one window on the
+ * server; removals and reorders are the only changes that make the
+ * owner replace the property, and it does so from this copy without
+ * reading anything back.
+ */
+typedef struct {
+	xcb_window_t	*windows;
+	uint32_t	len;
+	uint32_t	cap;
+} wm_ewmh_list_t;
+
+bool ewmh_list_init(wm_ewmh_list_t *list, const uint32_t cap);
+void ewmh_list_free(wm_ewmh_list_t *list);
+bool ewmh_list_append(wm_ewmh_list_t *list, const xcb_window_t window);
+bool ewmh_list_remove(wm_ewmh_list_t *list, const xcb_window_t window);
+bool ewmh_list_raise(wm_ewmh_list_t *list, const xcb_window_t window);
+
+#endif
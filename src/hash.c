@@ -0,0 +1,171 @@
+#include <stdlib.h>
+
+#include "hash.h"
+
+#define HASH_MIN_BITS 6
+#define HASH_MIN_CAP (1u << HASH_MIN_BITS)
+
+static inline uint32_t
+hash_bucket(const wm_hash_t *hash, const uint32_t key)
+{
+	// Fibonacci hashing: the top bits of the product depend on every bit
+	// of the key, including the client base X puts in the high bits
+	return (key * 2654435769u) >> hash->shift;
+}
+
+bool
+hash_init(wm_hash_t *hash, uint32_t cap)
+{
+	uint32_t size = HASH_MIN_CAP;
+	uint32_t shift = 32 - HASH_MIN_BITS;
+
+	while (size < cap)
+	{
+		size <<= 1;
+		--shift;
+	}
+
+	hash->keys = calloc(size, sizeof(uint32_t));
+	hash->slots = calloc(size, sizeof(uint32_t));
+	hash->cap = size;
+	hash->len = 0;
+	hash->shift = shift;
+
+	if (!hash->keys || !hash->slots)
+	{
+		hash_free(hash);
+		return false;
+	}
+
+	return true;
+}
+
+void
+hash_free(wm_hash_t *hash)
+{
+	free(hash->keys);
+	free(hash->slots);
+	hash->keys = NULL;
+	hash->slots = NULL;
+	hash->cap = 0;
+	hash->len = 0;
+	hash->shift = 0;
+}
+
+static bool
+hash_grow(wm_hash_t *hash)
+{
+	wm_hash_t bigger;
+
+	if (!hash_init(&bigger, hash->cap << 1))
+	{
+		return false;
+	}
+
+	for (uint32_t i = 0; i < hash->cap; ++i)
+	{
+		if (hash->keys[i] != 0)
+		{
+			hash_insert(&bigger, hash->keys[i], hash->slots[i]);
+		}
+	}
+
+	hash_free(hash);
+	*hash = bigger;
+
+	return true;
+}
+
+bool
+hash_insert(wm_hash_t *hash, const uint32_t key, const uint32_t slot)
+{
+	if (key == 0)
+	{
+		return false;
+	}
+
+	if ((hash->len + 1) * 2 > hash->cap && !hash_grow(hash))
+	{
+		return false;
+	}
+
+	uint32_t i = hash_bucket(hash, key);
+
+	while (hash->keys[i] != 0 && hash->keys[i] != key)
+	{
+		i = (i + 1) & (hash->cap - 1);
+	}
+
+	if (hash->keys[i] == 0)
+	{
+		hash->keys[i] = key;
+		++hash->len;
+	}
+
+	hash->slots[i] = slot;
+
+	return true;
+}
+
+int32_t
+hash_find(const wm_hash_t *hash, const uint32_t key)
+{
+	if (hash->cap == 0 || key == 0)
+	{
+		return -1;
+	}
+
+	for (uint32_t i = hash_bucket(hash, key);
+			hash->keys[i] != 0;
+			i = (i + 1) & (hash->cap - 1))
+	{
+		if (hash->keys[i] == key)
+		{
+			return hash->slots[i];
+		}
+	}
+
+	return -1;
+}
+
+/*
+ * Remove by shifting later entries of the probe run back into the hole,
+ * so no tombstones build up as windows come and go.
+ */
+void
+hash_remove(wm_hash_t *hash, const uint32_t key)
+{
+	if (hash->cap == 0 || key == 0)
+	{
+		return;
+	}
+
+	const uint32_t mask = hash->cap - 1;
+	uint32_t i = hash_bucket(hash, key);
+
+	while (hash->keys[i] != key)
+	{
+		if (hash->keys[i] == 0)
+		{
+			return;
+		}
+
+		i = (i + 1) & mask;
+	}
+
+	for (uint32_t j = (i + 1) & mask; hash->keys[j] != 0; j = (j + 1) & mask)
+	{
+		const uint32_t home = hash_bucket(hash, hash->keys[j]);
+
+		// Entry j may move into the hole only if its home is not in (i, j]
+		if (((j - home) & mask) >= ((j - i) & mask))
+		{
+			hash->keys[i] = hash->keys[j];
+			hash->slots[i] = hash->slots[j];
+			i = j;
+		}
+	}
+
+	hash->keys[i] = 0;
+	--hash->len;
+}
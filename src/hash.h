@@ -0,0 +1,29 @@
+#ifndef MARTWM_HASH_H
+#define MARTWM_HASH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Open-addressing (linear probing) hash index from a non-zero 32-bit key,
+ * such as an X window id, to a slot number. Key 0 marks an empty bucket.
+ * The table doubles whenever it becomes more than half full, so lookups
+ * stay constant-time no matter how many keys it holds.
+ */
+typedef struct {
+	uint32_t	*keys;
+	uint32_t	*slots;
+	uint32_t	cap;
+	uint32_t	len;
+
+	// 32 - log2(cap), buckets come from the top bits of the product
+	uint32_t	shift;
+} wm_hash_t;
+
+bool hash_init(wm_hash_t *hash, uint32_t cap);
+void hash_free(wm_hash_t *hash);
+bool hash_insert(wm_hash_t *hash, const uint32_t key, const uint32_t slot);
+void hash_remove(wm_hash_t *hash, const uint32_t key);
+int32_t hash_find(const wm_hash_t *hash, const uint32_t key);
+
+#endif
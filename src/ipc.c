@@ -0,0 +1,462 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "ipc.h"
+
+static bool
+ipc_nonblock(const int fd)
+{
+	const int flags = fcntl(fd, F_GETFL);
+
+	return flags != -1 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) != -1 &&
+		fcntl(fd, F_SETFD, FD_CLOEXEC) != -1;
+}
+
+static wm_ipc_client_t *
+ipc_client(wm_ipc_t *ipc, const int fd)
+{
+	for (uint32_t i = 0; i < IPC_MAX_CLIENTS; ++i)
+	{
+		if (ipc->clients[i].fd == fd)
+		{
+			return &ipc->clients[i];
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Send what the socket takes right now. Returns the bytes sent, 0 when it
+ * is full, or -1 when the client is gone.
+ */
+static ssize_t
+ipc_send(const int fd, const char *data, const size_t len)
+{
+	ssize_t sent;
+
+	do
+	{
+		sent = send(fd, data, len, MSG_NOSIGNAL);
+	}
+	while (sent == -1 && errno == EINTR);
+
+	if (sent == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+	{
+		return 0;
+	}
+
+	return sent;
+}
+
+/*
+ * Keep what the socket did not take until ipc_flush() can send it.
+ */
+static bool
+ipc_queue(wm_ipc_t *ipc, wm_ipc_client_t *client, const char *data, const size_t len)
+{
+	char *out = NULL;
+
+	if (client->out_len + len <= IPC_OUT_MAX)
+	{
+		out = realloc(client->out, client->out_len + len);
+	}
+
+	if (!out)
+	{
+		fprintf(stderr, "WARNING: IPC client %d stopped reading, dropped\n", client->fd);
+		ipc_drop(ipc, client->fd);
+		return false;
+	}
+
+	if (client->out_len == 0)
+	{
+		ipc->writable(client->fd, true);
+	}
+
+	memcpy(out + client->out_len, data, len);
+	client->out = out;
+	client->out_len += len;
+
+	return true;
+}
+
+/*
+ * Send a buffer, queueing whatever the socket cannot take yet. Returns
+ * false if the client was dropped.
+ */
+bool
+ipc_write(wm_ipc_t *ipc, wm_ipc_client_t *client, const char *line, const size_t len)
+{
+	size_t sent = 0;
+
+	// Behind anything already queued, to keep the order
+	if (client->out_len == 0)
+	{
+		const ssize_t got = ipc_send(client->fd, line, len);
+
+		if (got == -1)
+		{
+			ipc_drop(ipc, client->fd);
+			return false;
+		}
+
+		sent = got;
+	}
+
+	return sent == len || ipc_queue(ipc, client, line + sent, len - sent);
+}
+
+/*
+ * Send queued output now that the client socket has room again.
+ */
+void
+ipc_flush(wm_ipc_t *ipc, const int fd)
+{
+	wm_ipc_client_t *client = ipc_client(ipc, fd);
+
+	if (fd == -1 || !client || client->out_len == 0)
+	{
+		return;
+	}
+
+	const ssize_t sent = ipc_send(fd, client->out, client->out_len);
+
+	if (sent == -1)
+	{
+		ipc_drop(ipc, fd);
+		return;
+	}
+
+	client->out_len -= sent;
+	memmove(client->out, client->out + sent, client->out_len);
+
+	if (client->out_len == 0)
+	{
+		free(client->out);
+		client->out = NULL;
+		ipc->writable(fd, false);
+	}
+}
+
+/*
+ * Format one line, keeping the newline when it has to be cut short.
+ * Control characters before it are blanked, so a window title holding a
+ * newline cannot forge lines of its own.
+ */
+static size_t
+ipc_format(char *line, const char *format, va_list args)
+{
+	int len = vsnprintf(line, IPC_LINE_MAX, format, args);
+
+	if (len <= 0)
+	{
+		return 0;
+	}
+
+	if (len >= IPC_LINE_MAX)
+	{
+		line[IPC_LINE_MAX - 2] = '\n';
+		len = IPC_LINE_MAX - 1;
+	}
+
+	for (int i = 0; i < len - 1; ++i)
+	{
+		if ((unsigned char) line[i] < 0x20 || line[i] == 0x7f)
+		{
+			line[i] = ' ';
+		}
+	}
+
+	return len;
+}
+
+/*
+ * Make dir, or accept it if it exists, only when no one but us can enter
+ * it. Sockets in it are then out of reach of other users, whatever their
+ * own mode.
+ */
+bool
+ipc_private_dir(const char *dir)
+{
+	struct stat st;
+
+	if (mkdir(dir, 0700) == -1 && errno != EEXIST)
+	{
+		perror("ipc mkdir");
+		return false;
+	}
+
+	if (lstat(dir, &st) == -1)
+	{
+		perror("ipc lstat");
+		return false;
+	}
+
+	if (!S_ISDIR(st.st_mode) || st.st_uid != getuid() || (st.st_mode & 077))
+	{
+		fprintf(stderr, "WARNING: %s is not a private directory, no IPC socket\n", dir);
+		return false;
+	}
+
+	return true;
+}
+
+bool
+ipc_init(wm_ipc_t *ipc, const char *path,
+		void (*command)(wm_ipc_client_t *client, char *line),
+		void (*dropped)(int fd),
+		void (*writable)(int fd, bool wait))
+{
+	struct sockaddr_un address = { .sun_family = AF_UNIX };
+	mode_t mask;
+	int bound;
+
+	memset(ipc, 0, sizeof(wm_ipc_t));
+	ipc->fd = -1;
+	ipc->command = command;
+	ipc->dropped = dropped;
+	ipc->writable = writable;
+
+	for (uint32_t i = 0; i < IPC_MAX_CLIENTS; ++i)
+	{
+		ipc->clients[i].fd = -1;
+	}
+
+	if (strlen(path) >= sizeof(address.sun_path))
+	{
+		fprintf(stderr, "WARNING: IPC socket path too long: %s\n", path);
+		return false;
+	}
+
+	snprintf(address.sun_path, sizeof(address.sun_path), "%s", path);
+
+	ipc->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (ipc->fd == -1 || !ipc_nonblock(ipc->fd))
+	{
+		perror("ipc socket");
+		ipc_free(ipc);
+		return false;
+	}
+
+	// A socket left behind by a crashed instance
+	unlink(path);
+
+	// Owner only: spawn runs anything as us
+	mask = umask(0177);
+	bound = bind(ipc->fd, (struct sockaddr *) &address, sizeof(address));
+	umask(mask);
+
+	if (bound == -1 || listen(ipc->fd, IPC_MAX_CLIENTS) == -1)
+	{
+		perror("ipc bind");
+		ipc_free(ipc);
+		return false;
+	}
+
+	snprintf(ipc->path, sizeof(ipc->path), "%s", path);
+
+	return true;
+}
+
+void
+ipc_free(wm_ipc_t *ipc)
+{
+	if (ipc->fd == -1)
+	{
+		return;
+	}
+
+	for (uint32_t i = 0; i < IPC_MAX_CLIENTS; ++i)
+	{
+		if (ipc->clients[i].fd != -1)
+		{
+			close(ipc->clients[i].fd);
+			ipc->clients[i].fd = -1;
+		}
+
+		free(ipc->clients[i].out);
+		ipc->clients[i].out = NULL;
+		ipc->clients[i].out_len = 0;
+	}
+
+	if (ipc->fd != -1)
+	{
+		close(ipc->fd);
+		ipc->fd = -1;
+	}
+
+	if (ipc->path[0] != '\0')
+	{
+		unlink(ipc->path);
+		ipc->path[0] = '\0';
+	}
+}
+
+/*
+ * Accept one pending connection. Returns its fd for the owner to watch,
+ * or -1 if there was none or no room for it.
+ */
+int
+ipc_accept(wm_ipc_t *ipc)
+{
+	const int fd = accept(ipc->fd, NULL, NULL);
+
+	if (fd == -1)
+	{
+		return -1;
+	}
+
+	wm_ipc_client_t *client = ipc_client(ipc, -1);
+
+	if (!client || !ipc_nonblock(fd))
+	{
+		close(fd);
+		return -1;
+	}
+
+	memset(client, 0, sizeof(wm_ipc_client_t));
+	client->fd = fd;
+
+	return fd;
+}
+
+void
+ipc_drop(wm_ipc_t *ipc, const int fd)
+{
+	wm_ipc_client_t *client = ipc_client(ipc, fd);
+
+	if (fd == -1 || !client)
+	{
+		return;
+	}
+
+	if (client->subscribed)
+	{
+		--ipc->subscribers;
+	}
+
+	close(fd);
+	free(client->out);
+	client->fd = -1;
+	client->subscribed = false;
+	client->out = NULL;
+	client->out_len = 0;
+	ipc->dropped(fd);
+}
+
+/*
+ * Read what a client sent and run each complete line as a command.
+ */
+void
+ipc_read(wm_ipc_t *ipc, const int fd)
+{
+	wm_ipc_client_t *client = ipc_client(ipc, fd);
+
+	if (!client)
+	{
+		return;
+	}
+
+	const ssize_t got = read(fd, client->in + client->in_len,
+			sizeof(client->in) - client->in_len);
+
+	if (got == -1 && (errno == EAGAIN || errno == EINTR))
+	{
+		return;
+	}
+
+	if (got <= 0)
+	{
+		ipc_drop(ipc, fd);
+		return;
+	}
+
+	client->in_len += got;
+
+	char *line = client->in;
+	char *end;
+
+	while (client->fd != -1 &&
+			(end = memchr(line, '\n', client->in_len - (line - client->in))))
+	{
+		*end = '\0';
+		ipc->command(client, line);
+		line = end + 1;
+	}
+
+	if (client->fd == -1)
+	{
+		return;
+	}
+
+	client->in_len -= line - client->in;
+	memmove(client->in, line, client->in_len);
+
+	if (client->in_len == sizeof(client->in))
+	{
+		ipc_reply(ipc, client, "error line too long\n");
+
+		ipc_drop(ipc, client->fd);
+	}
+}
+
+void
+ipc_reply(wm_ipc_t *ipc, wm_ipc_client_t *client, const char *format, ...)
+{
+	char line[IPC_LINE_MAX];
+	va_list args;
+
+	va_start(args, format);
+	const size_t len = ipc_format(line, format, args);
+	va_end(args);
+
+	if (len > 0)
+	{
+		ipc_write(ipc, client, line, len);
+	}
+}
+
+/*
+ * Broadcast an event line to the subscribers. Formatting is skipped
+ * entirely while nobody listens.
+ */
+void
+ipc_event(wm_ipc_t *ipc, const char *format, ...)
+{
+	char line[IPC_LINE_MAX];
+	va_list args;
+
+	if (ipc->subscribers == 0)
+	{
+		return;
+	}
+
+	va_start(args, format);
+	const size_t len = ipc_format(line, format, args);
+	va_end(args);
+
+	if (len == 0)
+	{
+		return;
+	}
+
+	for (uint32_t i = 0; i < IPC_MAX_CLIENTS; ++i)
+	{
+		if (ipc->clients[i].fd != -1 && ipc->clients[i].subscribed)
+		{
+			ipc_write(ipc, &ipc->clients[i], line, len);
+		}
+	}
+}
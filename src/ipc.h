@@ -0,0 +1,58 @@
+#ifndef MARTWM_IPC_H
+#define MARTWM_IPC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <stddef.h>
+
+#include <sys/un.h>
+
+#define IPC_MAX_CLIENTS 8
+#define IPC_LINE_MAX 256
+#define IPC_OUT_MAX (1 << 20)
+
+typedef struct {
+	int		fd;
+	char		in[IPC_LINE_MAX];
+	uint32_t	in_len;
+	bool		subscribed;
+	char		*out;
+	size_t		out_len;
+} wm_ipc_client_t;
+
+/*
+ * Unix-domain control socket. Clients send one command per line and get
+ * a reply ending in "ok" or "error ..." per command; subscribed clients
+ * also receive one line per WM event. Every socket is non-blocking: what a
+ * client socket cannot take is queued, and writable() asks the owner to
+ * call ipc_flush() once it can. A client more than IPC_OUT_MAX bytes
+ * behind is dropped, so a stuck script can never stall the WM. The owner
+ * watches the fds in its event loop and is told through dropped() when
+ * one goes away.
+ */
+typedef struct {
+	int		fd;
+	char		path[sizeof(((struct sockaddr_un *) 0)->sun_path)];
+	wm_ipc_client_t	clients[IPC_MAX_CLIENTS];
+	uint32_t	subscribers;
+	void		(*command)(wm_ipc_client_t *client, char *line);
+	void		(*dropped)(int fd);
+	void		(*writable)(int fd, bool wait);
+} wm_ipc_t;
+
+bool ipc_private_dir(const char *dir);
+bool ipc_init(wm_ipc_t *ipc, const char *path,
+		void (*command)(wm_ipc_client_t *client, char *line),
+		void (*dropped)(int fd),
+		void (*writable)(int fd, bool wait));
+void ipc_free(wm_ipc_t *ipc);
+int ipc_accept(wm_ipc_t *ipc);
+void ipc_read(wm_ipc_t *ipc, const int fd);
+void ipc_flush(wm_ipc_t *ipc, const int fd);
+void ipc_drop(wm_ipc_t *ipc, const int fd);
+bool ipc_write(wm_ipc_t *ipc, wm_ipc_client_t *client, const char *line, const size_t len);
+void ipc_reply(wm_ipc_t *ipc, wm_ipc_client_t *client, const char *format, ...);
+void ipc_event(wm_ipc_t *ipc, const char *format, ...);
+
+#endif
@@ -0,0 +1,195 @@
+// POSIX_SPAWN_SETSID is a GNU extension until POSIX 2024
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include <spawn.h>
+#include <sys/wait.h>
+#include <sys/signalfd.h>
+#include <unistd.h>
+
+#include "launch.h"
+
+#ifndef POSIX_SPAWN_SETSID
+// Older libcs: a process group of its own still keeps the child out of
+// the WM's job control
+#define POSIX_SPAWN_SETSID 0
+#define LAUNCH_SETPGROUP POSIX_SPAWN_SETPGROUP
+#else
+#define LAUNCH_SETPGROUP 0
+#endif
+
+static uint64_t
+launch_now(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+bool
+launch_init(wm_launch_t *launch)
+{
+	sigset_t chld;
+
+	memset(launch, 0, sizeof(wm_launch_t));
+	launch->fd = -1;
+
+	sigemptyset(&chld);
+	sigaddset(&chld, SIGCHLD);
+
+	// Before any thread exists, so they all inherit the blocked SIGCHLD
+	if (sigprocmask(SIG_BLOCK, &chld, &launch->mask) == -1)
+	{
+		perror("launch sigprocmask");
+		return false;
+	}
+
+	launch->fd = signalfd(-1, &chld, SFD_NONBLOCK | SFD_CLOEXEC);
+	if (launch->fd == -1)
+	{
+		perror("launch signalfd");
+
+		// Let the kernel reap the children instead
+		sigprocmask(SIG_SETMASK, &launch->mask, NULL);
+		sigaction(SIGCHLD, &(struct sigaction) {
+				.sa_handler = SIG_DFL,
+				.sa_flags = SA_NOCLDWAIT
+			}, NULL);
+
+		return false;
+	}
+
+	// Children inherited from whatever exec'd the WM
+	launch_reap(launch);
+
+	return true;
+}
+
+void
+launch_free(wm_launch_t *launch)
+{
+	if (launch->fd == -1)
+	{
+		return;
+	}
+
+	close(launch->fd);
+	launch->fd = -1;
+
+	sigprocmask(SIG_SETMASK, &launch->mask, NULL);
+}
+
+/*
+ * Start argv[0], looked up in PATH. Returns the child's pid, or -1 with
+ * the reason printed.
+ */
+pid_t
+launch_spawn(wm_launch_t *launch, char *const argv[])
+{
+	extern char **environ;
+	posix_spawnattr_t attr;
+	pid_t pid;
+	int error;
+
+	if (!argv[0])
+	{
+		return -1;
+	}
+
+	error = posix_spawnattr_init(&attr);
+	if (error == 0)
+	{
+		posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK |
+				POSIX_SPAWN_SETSID | LAUNCH_SETPGROUP);
+		posix_spawnattr_setsigmask(&attr, &launch->mask);
+
+		error = posix_spawnp(&pid, argv[0], NULL, &attr, argv, environ);
+		posix_spawnattr_destroy(&attr);
+	}
+
+	if (error != 0)
+	{
+		fprintf(stderr, "WARNING: Cannot launch %s: %s\n", argv[0], strerror(error));
+		return -1;
+	}
+
+	// Untracked children are still reaped, only not listed
+	if (launch->len < LAUNCH_MAX_CHILDREN)
+	{
+		wm_child_t *child = &launch->children[launch->len++];
+
+		child->pid = pid;
+		child->started = launch_now();
+		snprintf(child->name, sizeof(child->name), "%s", argv[0]);
+	}
+
+	return pid;
+}
+
+/*
+ * Start a command line split on blanks, without any shell quoting.
+ */
+pid_t
+launch_command(wm_launch_t *launch, const char *line)
+{
+	char buffer[256];
+	char *argv[LAUNCH_MAX_ARGS];
+	uint32_t argc = 0;
+
+	snprintf(buffer, sizeof(buffer), "%s", line);
+
+	for (char *arg = strtok(buffer, " \t"); arg && argc < LAUNCH_MAX_ARGS - 1;
+			arg = strtok(NULL, " \t"))
+	{
+		argv[argc++] = arg;
+	}
+
+	argv[argc] = NULL;
+
+	return launch_spawn(launch, argv);
+}
+
+/*
+ * Drain the signalfd and collect every exited child. SIGCHLD does not
+ * queue, so one notification can stand for several exits. Returns the
+ * number of tracked children that went away.
+ */
+uint32_t
+launch_reap(wm_launch_t *launch)
+{
+	struct signalfd_siginfo info;
+	uint32_t reaped = 0;
+	pid_t pid;
+	int status;
+
+	while (read(launch->fd, &info, sizeof(info)) == sizeof(info));
+
+	while ((pid = waitpid(-1, &status, WNOHANG)) > 0)
+	{
+		for (uint32_t i = 0; i < launch->len; ++i)
+		{
+			if (launch->children[i].pid != pid)
+			{
+				continue;
+			}
+
+			if (WIFSIGNALED(status))
+			{
+				fprintf(stderr, "%s (%d) killed by signal %d\n",
+						launch->children[i].name, (int) pid, WTERMSIG(status));
+			}
+
+			launch->children[i] = launch->children[--launch->len];
+			++reaped;
+			break;
+		}
+	}
+
+	return reaped;
+}
@@ -0,0 +1,40 @@
+#ifndef MARTWM_LAUNCH_H
+#define MARTWM_LAUNCH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <signal.h>
+#include <sys/types.h>
+
+#define LAUNCH_MAX_CHILDREN 64
+#define LAUNCH_MAX_ARGS 16
+
+typedef struct {
+	pid_t		pid;
+	char		name[32];
+	uint64_t	started;
+} wm_child_t;
+
+/*
+ * Process launcher. Programs are started with posix_spawnp(), which glibc
+ * implements with a vfork-style clone, so the cost does not grow with the
+ * WM's address space. SIGCHLD is blocked and delivered through a signalfd
+ * the owner watches in its event loop; launch_reap() then collects every
+ * exited child, so none is left a zombie. The children get the signal
+ * mask the WM started with and a session of their own.
+ */
+typedef struct {
+	int		fd;
+	sigset_t	mask;
+	wm_child_t	children[LAUNCH_MAX_CHILDREN];
+	uint32_t	len;
+} wm_launch_t;
+
+bool launch_init(wm_launch_t *launch);
+void launch_free(wm_launch_t *launch);
+pid_t launch_spawn(wm_launch_t *launch, char *const argv[]);
+pid_t launch_command(wm_launch_t *launch, const char *line);
+uint32_t launch_reap(wm_launch_t *launch);
+
+#endif
@@ -0,0 +1,99 @@
+#include "layout.h"
+
+/*
+ * Split length into parts that differ by at most one pixel, the earlier
+ * parts taking the remainder. Returns the offset and size of part i.
+ */
+static void
+layout_split(const int32_t start, const int32_t length,
+		const uint32_t parts, const uint32_t i,
+		int32_t *offset, int32_t *size)
+{
+	const int32_t base = length / parts;
+	const int32_t extra = length % parts;
+
+	*offset = start + base * i + ((int32_t) i < extra ? (int32_t) i : extra);
+	*size = base + ((int32_t) i < extra ? 1 : 0);
+}
+
+static void
+layout_master(const xcb_rectangle_t *area, const uint32_t count,
+		const uint32_t master_percent, xcb_rectangle_t *out)
+{
+	if (count == 1)
+	{
+		out[0] = *area;
+		return;
+	}
+
+	const int32_t master_width = area->width * master_percent / 100;
+
+	out[0] = (xcb_rectangle_t) { area->x, area->y, master_width, area->height };
+
+	for (uint32_t i = 1; i < count; ++i)
+	{
+		int32_t y;
+		int32_t height;
+
+		layout_split(area->y, area->height, count - 1, i - 1, &y, &height);
+
+		out[i] = (xcb_rectangle_t) {
+			area->x + master_width, y,
+			area->width - master_width, height
+		};
+	}
+}
+
+static void
+layout_grid(const xcb_rectangle_t *area, const uint32_t count, xcb_rectangle_t *out)
+{
+	uint32_t columns = 1;
+
+	while (columns * columns < count)
+	{
+		++columns;
+	}
+
+	const uint32_t rows = (count + columns - 1) / columns;
+
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		const uint32_t row = i / columns;
+		// The last row may be short, its windows share the full width
+		const uint32_t in_row = (row == rows - 1) ? count - row * columns : columns;
+		int32_t x, width, y, height;
+
+		layout_split(area->x, area->width, in_row, i % columns, &x, &width);
+		layout_split(area->y, area->height, rows, row, &y, &height);
+
+		out[i] = (xcb_rectangle_t) { x, y, width, height };
+	}
+}
+
+/*
+ * Outer rectangles for count windows tiled in area, the first one being
+ * the master. A pure function of its arguments, so the caller can diff
+ * the result against what the windows already have.
+ */
+void
+layout_arrange(const uint32_t mode,
+		const xcb_rectangle_t *area,
+		const uint32_t count,
+		const uint32_t master_percent,
+		xcb_rectangle_t *out)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	switch (mode)
+	{
+	case LAYOUT_MASTER:
+		layout_master(area, count, master_percent, out);
+		break;
+	case LAYOUT_GRID:
+		layout_grid(area, count, out);
+		break;
+	}
+}
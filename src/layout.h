@@ -0,0 +1,21 @@
+#ifndef MARTWM_LAYOUT_H
+#define MARTWM_LAYOUT_H
+
+#include <stdint.h>
+
+#include <xcb/xcb.h>
+
+enum {
+	LAYOUT_FLOATING,
+	LAYOUT_MASTER,
+	LAYOUT_GRID,
+	LAYOUT_ALL
+};
+
+void layout_arrange(const uint32_t mode,
+		const xcb_rectangle_t *area,
+		const uint32_t count,
+		const uint32_t master_percent,
+		xcb_rectangle_t *out);
+
+#endif
@@ -1,3 +1,5 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
@@ -6,6 +8,7 @@
 #include <xcb/xcb.h>
 #include <xcb/xcb_keysyms.h>
 #include <xcb/randr.h>
+#include <xcb/sync.h>
 
 #include <X11/keysym.h>
 #include <X11/cursorfont.h>
@@ -16,6 +19,23 @@
 
 #include <sys/types.h> 
 #include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "window.h"
+#include "stats.h"
+#include "monitor.h"
+#include "snap.h"
+#include "place.h"
+#include "layout.h"
+#include "ipc.h"
+#include "status.h"
+#include "launch.h"
+#include "ewmh.h"
 
 const int32_t MIN_WIDTH = 20;
 const int32_t MIN_HEIGHT = 20;
@@ -32,150 +52,467 @@ const int32_t MIN_HEIGHT = 20;
 #define CONFIG_FONT		"Monospace 10"
 #define CONFIG_BAR_HEIGHT	18
 #define CONFIG_FRAME_BAR	18
+#define CONFIG_FRAME_BORDER	2
+
+// Interactive resize pacing: clients without _NET_WM_SYNC_REQUEST get at
+// most one resize per interval, synced clients are waited on for at most
+// the timeout before the WM carries on without them.
+#define CONFIG_RESIZE_INTERVAL_MS	16
+#define CONFIG_SYNC_TIMEOUT_MS		100
 
 #define CONFIG_COLOR_FRAME_BACK_FOCUS	0x666699
 #define CONFIG_COLOR_FRAME_BACK_UNFOCUS	0x888888
 #define CONFIG_COLOR_FRAME_BORDER_FOCUS 	0xFF9933
 #define CONFIG_COLOR_FRAME_BORDER_UNFOCUS	0x777777
+#define CONFIG_COLOR_FRAME_TEXT_FOCUS	0xFFFFFF
+#define CONFIG_COLOR_FRAME_TEXT_UNFOCUS	0x000000
+
+// Frame decorations are rendered at widths rounded up to this step, so
+// resizing only re-renders them when a bucket boundary is crossed
+#define CONFIG_FRAME_BUCKET	128
+
+// Moved windows snap to monitor and window edges this close, in pixels
+#define CONFIG_SNAP_DISTANCE	12
+
+// Share of the monitor width the master window gets when tiling
+#define CONFIG_MASTER_PERCENT	55
+
+// Workspaces per monitor, shown with Mod4-1 to Mod4-9
+#define CONFIG_WORKSPACES	9
+
+// Programs started with Mod4-<key>, arguments split on blanks
+static const struct {
+	xcb_keysym_t	keysym;
+	const char	*command;
+} config_commands[] = {
+	{ XK_d,		"dmenu_run" },
+	{ XK_Return,	"xterm" },
+};
 
-#define WM_MAX_WINDOWS 64
-#define WM_MAX_MONITORS 16
+#define WM_WINDOWS_INIT 64
+#define WM_MAX_MONITORS MONITOR_MAX
+#define WM_MAX_FDS 32
+#define WM_LAYOUT_CACHE 16
 
 enum {
 	WM_ATOMS_PROTOCOLS, 
 	WM_ATOMS_DELETE,
 	WM_ATOMS_STATE,
 	WM_ATOMS_TAKEFOCUS,
+	WM_ATOMS_NET_WM_NAME,
+	WM_ATOMS_UTF8_STRING,
+	WM_ATOMS_SYNC_REQUEST,
+	WM_ATOMS_SYNC_REQUEST_COUNTER,
+	WM_ATOMS_NET_SUPPORTED,
+	WM_ATOMS_NET_SUPPORTING_WM_CHECK,
+	WM_ATOMS_NET_CLIENT_LIST,
+	WM_ATOMS_NET_CLIENT_LIST_STACKING,
+	WM_ATOMS_NET_ACTIVE_WINDOW,
+	WM_ATOMS_NET_WM_STATE,
+	WM_ATOMS_NET_WM_STATE_FULLSCREEN,
 
 	WM_ATOMS_ALL
 };
 
+enum {
+	WM_CURSOR_NORMAL,
+	WM_CURSOR_MOVE,
+	WM_CURSOR_RESIZE,
+	WM_CURSOR_TOP,
+	WM_CURSOR_BOTTOM,
+	WM_CURSOR_LEFT,
+	WM_CURSOR_RIGHT,
+	WM_CURSOR_TOP_LEFT,
+	WM_CURSOR_TOP_RIGHT,
+	WM_CURSOR_BOTTOM_LEFT,
+	WM_CURSOR_BOTTOM_RIGHT,
+
+	WM_CURSOR_ALL
+};
+
+/*
+ * Everything the WM reads from a window before it manages it. All the
+ * requests are sent by adopt_request() and the replies collected by
+ * adopt_finish(), so adopting costs one round trip of latency.
+ */
 typedef struct {
-	xcb_window_t	frame;
-	xcb_window_t 	id;
-	char		name[64];
-	bool		visible;
-} wm_window_t;
+	xcb_window_t			window;
+	bool				mapped;
+	xcb_get_geometry_cookie_t	geometry;
+	xcb_get_property_cookie_t	name;
+	xcb_get_property_cookie_t	net_name;
+	xcb_get_property_cookie_t	protocols;
+	xcb_get_property_cookie_t	normal_hints;
+	xcb_get_property_cookie_t	hints;
+	xcb_get_property_cookie_t	class;
+	xcb_get_property_cookie_t	transient;
+	xcb_get_property_cookie_t	sync_counter;
+	xcb_get_property_cookie_t	net_state;
+} wm_adopt_t;
+
+/*
+ * Requests main() sends before it reads any reply, so startup waits for
+ * the server a couple of times rather than once per request.
+ */
+typedef struct {
+	xcb_intern_atom_cookie_t		atoms[WM_ATOMS_ALL];
+	xcb_void_cookie_t			root;
+	xcb_query_tree_cookie_t			tree;
+	const xcb_query_extension_reply_t	*randr;
+	xcb_randr_query_version_cookie_t	randr_version;
+	xcb_randr_get_screen_resources_current_cookie_t randr_resources;
+	const xcb_query_extension_reply_t	*sync;
+	xcb_sync_initialize_cookie_t		sync_init;
+} wm_startup_t;
+
+enum {
+	WM_DRAG_NONE,
+	WM_DRAG_MOVE,
+	WM_DRAG_RESIZE
+};
+
+// Frame sides a resize moves
+enum {
+	WM_EDGE_LEFT	= 1 << 0,
+	WM_EDGE_RIGHT	= 1 << 1,
+	WM_EDGE_TOP	= 1 << 2,
+	WM_EDGE_BOTTOM	= 1 << 3
+};
 
+/*
+ * Interactive move/resize state, recorded once on button press so that
+ * motion events never have to ask the server where the window or the
+ * pointer is.
+ */
 typedef struct {
-	xcb_rectangle_t rect;
-} wm_monitor_t;
+	uint8_t		mode;
+	uint8_t		edges;
+	xcb_window_t	frame;
+	wm_handle_t	window;
+	int16_t		pointer_x;
+	int16_t		pointer_y;
+	xcb_rectangle_t	start;
+	xcb_rectangle_t	last;
+
+	// Resize waiting to be sent, see drag_resize_flush()
+	bool		pending;
+	uint64_t	resized;
+} wm_drag_t;
 
 static xcb_connection_t *connection = NULL;
 static xcb_drawable_t 	root;
 static xcb_key_symbols_t *syms;
 static xcb_atom_t 	wm_atoms[WM_ATOMS_ALL];
-static wm_window_t 	windows[WM_MAX_WINDOWS] = { 0 };
-static uint32_t		windows_len = 0;
+static xcb_cursor_t	cursors[WM_CURSOR_ALL];
+
+// Resize cursor for each combination of drag edges
+static const uint8_t	edge_cursors[WM_EDGE_BOTTOM << 1] = {
+	[0] = WM_CURSOR_RESIZE,
+	[WM_EDGE_LEFT] = WM_CURSOR_LEFT,
+	[WM_EDGE_RIGHT] = WM_CURSOR_RIGHT,
+	[WM_EDGE_TOP] = WM_CURSOR_TOP,
+	[WM_EDGE_BOTTOM] = WM_CURSOR_BOTTOM,
+	[WM_EDGE_TOP | WM_EDGE_LEFT] = WM_CURSOR_TOP_LEFT,
+	[WM_EDGE_TOP | WM_EDGE_RIGHT] = WM_CURSOR_TOP_RIGHT,
+	[WM_EDGE_BOTTOM | WM_EDGE_LEFT] = WM_CURSOR_BOTTOM_LEFT,
+	[WM_EDGE_BOTTOM | WM_EDGE_RIGHT] = WM_CURSOR_BOTTOM_RIGHT
+};
+static wm_table_t	table = { 0 };
+static uint32_t		stack_top = 0;
 static xcb_screen_t 	*screen;
 
 static wm_window_t	current = { 0 };
+static wm_drag_t	drag = { 0 };
+
+// Server time of the latest event that carried one, for requests made
+// outside of any event
+static xcb_timestamp_t	event_time = XCB_CURRENT_TIME;
 
 static xcb_window_t	overview;
 
-// Bar
-static xcb_window_t	bar;
+// EWMH: the check window and the root list properties as last published
+static xcb_window_t	ewmh_check = 0;
+static wm_ewmh_list_t	ewmh_clients = { 0 };
+static wm_ewmh_list_t	ewmh_stacking = { 0 };
+
+/*
+ * The bar is composed off-screen in a persistent back-buffer pixmap with
+ * its own cairo context, then put on screen with a single copy.
+ */
+typedef struct {
+	xcb_window_t	window;
+	xcb_pixmap_t	pixmap;
+	xcb_gcontext_t	gc;
+	cairo_surface_t	*surface;
+	cairo_t		*cr;
+	uint16_t	width;
+	uint16_t	height;
+	bool		visible;
+
+	// What the back-buffer currently shows; the title is the workspace
+	// number followed by a whole window name
+	char		title[16 + sizeof(((wm_window_t *) 0)->name)];
+	char		status[96];
+	bool		dirty;
+} wm_bar_t;
+
+/*
+ * The windows of one workspace, linked through their table entries so a
+ * switch visits its members and nothing else. An empty workspace has no
+ * valid head.
+ */
+typedef struct {
+	int32_t		head;
+	uint32_t	len;
+} wm_workspace_t;
+
+typedef struct {
+	xcb_randr_crtc_t crtc;
+	xcb_rectangle_t rect;
+	wm_bar_t	bar;
+	wm_place_t	place;
+	uint32_t	layout;
+	bool		layout_dirty;
+	wm_workspace_t	workspaces[CONFIG_WORKSPACES];
+	uint32_t	workspace;
+} wm_monitor_t;
+
+/*
+ * Shaped layouts for recently drawn strings, so switching focus back and
+ * forth between windows never shapes the same title twice. Entries are
+ * keyed on the whole string, the hash and length only rule out misses.
+ */
+typedef struct {
+	PangoLayout	*layout;
+	char		*text;
+	size_t		len;
+	uint32_t	hash;
+	uint32_t	used;
+} wm_layout_cache_t;
+
+static uint8_t		sync_event_base = 0;
+
+// SYNC alarm id to table slot, kept apart from the window id index
+static wm_hash_t	sync_alarms = { 0 };
+
+// Bars, one per monitor
 static bool		bar_visible = true;
-static const uint32_t	bar_height = CONFIG_BAR_HEIGHT;
-static xcb_gcontext_t 	bar_gc;
 
-static uint32_t 		values[3];
-static xcb_get_geometry_reply_t	*geom;
 static bool			running = false;
 
 static wm_monitor_t	monitors[WM_MAX_MONITORS] = { 0 };
 static uint32_t		monitors_len = 0;
+static bool		monitors_dirty = false;
+static wm_monitor_grid_t monitor_grid;
+static wm_snap_t	snap;
+static uint32_t		order_top = 0;
+static wm_ipc_t		ipc = { .fd = -1 };
+static wm_launch_t	launch = { .fd = -1 };
+static wm_status_t	status[STATUS_ALL];
+static char		status_text[96] = "";
 
 static xcb_visualtype_t	*visual_type = NULL;
 
-static cairo_surface_t 	*cr_surface = NULL;
-static cairo_t		*cr = NULL;
-static PangoLayout 	*pa_layout = NULL;
+// Main loop
+static struct pollfd	loop_fds[WM_MAX_FDS];
+static void		(*loop_handlers[WM_MAX_FDS])(int);
+static uint32_t		loop_fds_len = 0;
+static uint32_t		loop_depth = 0;
+
+// Windows with title requests in flight, see title_request()
+static uint32_t		titles_pending = 0;
+static volatile sig_atomic_t stats_requested = 0;
+
+static PangoContext	*pa_context = NULL;
+static PangoFontDescription *pa_desc = NULL;
+static pthread_t	text_render_thread;
+static int		text_render_pipe[2] = { -1, -1 };
+static bool		text_render_ready = false;
+static uint64_t		start_ms = 0;
+
+static wm_layout_cache_t layout_cache[WM_LAYOUT_CACHE] = { 0 };
+static uint32_t		layout_tick = 0;
+
+/*
+ * Scan the fonts and load CONFIG_FONT once so the first draw does not pay
+ * for it. Runs on its own thread unless MARTWM_SYNC_FONTS is set; the
+ * thread only touches pa_context and tells the loop through a pipe.
+ */
+void *
+text_render_load(void *arg)
+{
+	(void) arg;
 
-void
-text_render_setup(void)
+	FcInit();
+
+	PangoFontMap *font_map = pango_cairo_font_map_new();
+	pa_context = pango_font_map_create_context(font_map);
+
+	PangoFont *font = pango_font_map_load_font(font_map, pa_context, pa_desc);
+	if (font)
+	{
+		g_object_unref(font);
+	}
+
+	g_object_unref(font_map);
+
+	if (text_render_pipe[1] != -1)
+	{
+		while (write(text_render_pipe[1], "", 1) == -1 && errno == EINTR);
+	}
+
+	return NULL;
+}
+
+/*
+ * FNV-1a over the len bytes of text.
+ */
+uint32_t
+text_render_hash(const char *text, const size_t len)
+{
+	uint32_t hash = 2166136261u;
+
+	for (size_t i = 0; i < len; ++i)
+	{
+		hash = (hash ^ (uint8_t) text[i]) * 16777619u;
+	}
+
+	return hash;
+}
+
+/*
+ * Return a layout holding text, shaping it only on a cache miss; the
+ * least recently used entry is recycled.
+ */
+PangoLayout *
+text_render_layout(const char *text)
 {
-	cr_surface = cairo_xcb_surface_create(connection,
-			root, visual_type,
-			screen->width_in_pixels,
-			screen->height_in_pixels);
+	const size_t len = strlen(text);
+	const uint32_t hash = text_render_hash(text, len);
+	wm_layout_cache_t *entry = &layout_cache[0];
+
+	for (uint32_t i = 0; i < WM_LAYOUT_CACHE; ++i)
+	{
+		if (layout_cache[i].text && layout_cache[i].hash == hash &&
+				layout_cache[i].len == len &&
+				memcmp(layout_cache[i].text, text, len) == 0)
+		{
+			layout_cache[i].used = ++layout_tick;
+			return layout_cache[i].layout;
+		}
+
+		if (layout_cache[i].used < entry->used)
+		{
+			entry = &layout_cache[i];
+		}
+	}
+
+	if (!entry->layout)
+	{
+		entry->layout = pango_layout_new(pa_context);
+		pango_layout_set_font_description(entry->layout, pa_desc);
+	}
 
-	cr = cairo_create(cr_surface);
-	cairo_paint(cr);
+	// Without a copy of the key the entry is still drawn, just never hit
+	free(entry->text);
+	entry->text = strdup(text);
+	entry->len = len;
+	entry->hash = hash;
+	entry->used = ++layout_tick;
 
-	pa_layout = pango_cairo_create_layout(cr);
-	PangoFontDescription *pa_desc = pango_font_description_from_string(CONFIG_FONT);
-	pango_layout_set_font_description(pa_layout, pa_desc);
-	pango_font_description_free(pa_desc);
-	pa_desc = NULL;
+	pango_layout_set_text(entry->layout, text, (int) len);
+
+	return entry->layout;
+}
+
+void
+text_render_color(cairo_t *cr, const uint32_t color)
+{
+	cairo_set_source_rgb(cr,
+			((color >> 16) & 0xFF) / 255.0,
+			((color >> 8) & 0xFF) / 255.0,
+			(color & 0xFF) / 255.0);
 }
 
 void
-text_render_draw(const xcb_window_t window,
+text_render_draw(cairo_t *cr,
 		const char *text,
 		const double x,
 		const double y,
-		const double r,
-		const double g,
-		const double b,
-		const double a)
+		const uint32_t color)
 {
-	static int32_t pa_height = 0;
-	xcb_get_geometry_cookie_t geom_cookie = xcb_get_geometry(
-			connection,
-			window);
-
-	xcb_get_geometry_reply_t *geom_reply = xcb_get_geometry_reply(
-			connection,
-			geom_cookie,
-			NULL);
-
-	if (!geom_reply)
+	// Text shows up once the fonts are loaded, see text_render_done()
+	if (!text_render_ready)
 	{
-		fprintf(stderr, "ERROR: Cannot get geometry of window"
-				" %d.\n", window);
 		return;
 	}
 
-	cairo_surface_flush(cr_surface);
-	cairo_xcb_surface_set_drawable(cr_surface,
-			window,
-			geom_reply->width,
-			geom_reply->height);
-
-	free(geom_reply);
+	PangoLayout *layout = text_render_layout(text);
 
-	pango_layout_set_text(pa_layout, text, -1);
-	cairo_set_source_rgba(cr, r, g, b, a);
+	text_render_color(cr, color);
 	cairo_move_to(cr, x, y);
-	pango_cairo_update_layout(cr, pa_layout);
-	pango_layout_get_size(pa_layout, NULL, &pa_height);
-	pango_cairo_show_layout(cr, pa_layout);
+	pango_cairo_show_layout(cr, layout);
+}
+
+int
+text_render_width(const char *text)
+{
+	int width = 0;
+
+	if (text_render_ready)
+	{
+		pango_layout_get_pixel_size(text_render_layout(text), &width, NULL);
+	}
 
-	cairo_surface_flush(cr_surface);
+	return width;
 }
 
 void
-text_render_destroy(void)
+text_render_join(void)
 {
-	g_object_unref(pa_layout);
-	pa_layout = NULL;
-	cairo_destroy(cr);
-	cr = NULL;
-	cairo_surface_destroy(cr_surface);
-	cr_surface = NULL;
+	if (text_render_pipe[0] == -1)
+	{
+		return;
+	}
+
+	pthread_join(text_render_thread, NULL);
+	close(text_render_pipe[0]);
+	close(text_render_pipe[1]);
+	text_render_pipe[0] = text_render_pipe[1] = -1;
 }
 
 void
-spawn(const char *cmd)
+text_render_destroy(void)
 {
-	if (fork()) return;
-	setsid();
-	execvp(cmd, (char *[2]) { (char *) cmd, NULL });
+	text_render_join();
+
+	for (uint32_t i = 0; i < WM_LAYOUT_CACHE; ++i)
+	{
+		if (layout_cache[i].layout)
+		{
+			g_object_unref(layout_cache[i].layout);
+			layout_cache[i].layout = NULL;
+		}
+
+		free(layout_cache[i].text);
+		layout_cache[i].text = NULL;
+	}
+
+	if (pa_desc)
+	{
+		pango_font_description_free(pa_desc);
+		pa_desc = NULL;
+	}
+
+	if (pa_context)
+	{
+		g_object_unref(pa_context);
+		pa_context = NULL;
+	}
 }
 
 void
-send_event(const xcb_window_t window, const xcb_atom_t proto)
+send_event(const xcb_window_t window, const xcb_atom_t proto, const xcb_timestamp_t time)
 {
 	xcb_client_message_event_t event = {
 		.response_type = XCB_CLIENT_MESSAGE,
@@ -185,7 +522,7 @@ send_event(const xcb_window_t window, const xcb_atom_t proto)
 		.type = wm_atoms[WM_ATOMS_PROTOCOLS],
 		.data.data32 = {
 			proto,
-			XCB_CURRENT_TIME
+			time
 		}
 	};
 
@@ -193,24 +530,6 @@ send_event(const xcb_window_t window, const xcb_atom_t proto)
 			(char *) &event);
 }
 
-void
-set_border(const xcb_window_t window, const bool focus)
-{
-#if 0
-	xcb_configure_window(connection,
-			window,
-			XCB_CONFIG_WINDOW_BORDER_WIDTH,
-			(uint32_t [1]) { CONFIG_BORDER_WIDTH });
-#endif
-
-	uint32_t color = (focus) ? CONFIG_COLOR_FRAME_BORDER_FOCUS : CONFIG_COLOR_FRAME_BORDER_UNFOCUS;
-
-	xcb_change_window_attributes(connection,
-			window,
-			XCB_CW_BORDER_PIXEL,
-			(uint32_t [1]) { color });
-}
-
 void
 setup_key(const xcb_keysym_t keysym)
 {
@@ -224,58 +543,126 @@ setup_key(const xcb_keysym_t keysym)
 }
 
 void
-set_focus(const xcb_window_t window)
+set_focus(const xcb_window_t window, const xcb_timestamp_t time)
 {
 	xcb_set_input_focus(connection,
 			XCB_INPUT_FOCUS_PARENT,
 			window,
-			XCB_CURRENT_TIME);
+			time);
+}
+
+xcb_get_property_cookie_t
+get_property(const xcb_window_t window, const xcb_atom_t property, const uint32_t len)
+{
+	return xcb_get_property(connection, 0, window,
+			property, XCB_GET_PROPERTY_TYPE_ANY,
+			0, len);
 }
 
-char *
-get_name(const xcb_window_t window)
+/*
+ * Publish a root list property from the WM's copy. A window just added
+ * at the end is sent on its own with PropModeAppend, any other change
+ * replaces the whole property.
+ */
+void
+ewmh_list_publish(const wm_ewmh_list_t *list, const uint32_t atom, const xcb_window_t appended)
 {
-	static char name[64] = { 0 };
-	xcb_get_property_cookie_t cookie = xcb_get_property(connection,
-			0, window,
-			XCB_ATOM_WM_NAME, XCB_ATOM_STRING,
-			0, 64);
+	if (appended)
+	{
+		xcb_change_property(connection, XCB_PROP_MODE_APPEND, root,
+				wm_atoms[atom], XCB_ATOM_WINDOW, 32, 1, &appended);
+	}
+	else
+	{
+		xcb_change_property(connection, XCB_PROP_MODE_REPLACE, root,
+				wm_atoms[atom], XCB_ATOM_WINDOW, 32, list->len, list->windows);
+	}
+}
 
-	xcb_get_property_reply_t *reply = xcb_get_property_reply(
-			connection, cookie, NULL);
+void
+ewmh_client_add(const xcb_window_t window)
+{
+	if (ewmh_list_append(&ewmh_clients, window))
+	{
+		ewmh_list_publish(&ewmh_clients, WM_ATOMS_NET_CLIENT_LIST, window);
+	}
 
-	if (reply)
+	if (ewmh_list_append(&ewmh_stacking, window))
 	{
-		int32_t len = xcb_get_property_value_length(reply);
-		memset(name, '\0', 64);
+		ewmh_list_publish(&ewmh_stacking, WM_ATOMS_NET_CLIENT_LIST_STACKING, window);
+	}
+}
 
-		if (len != 0)
-		{
-			snprintf(name, 64, "%.*s",
-					len,
-					(char *) xcb_get_property_value(reply));
-		}
+void
+ewmh_client_remove(const xcb_window_t window)
+{
+	if (ewmh_list_remove(&ewmh_clients, window))
+	{
+		ewmh_list_publish(&ewmh_clients, WM_ATOMS_NET_CLIENT_LIST, 0);
+	}
 
-		free(reply);
+	if (ewmh_list_remove(&ewmh_stacking, window))
+	{
+		ewmh_list_publish(&ewmh_stacking, WM_ATOMS_NET_CLIENT_LIST_STACKING, 0);
+	}
+}
 
-		return name;
+void
+ewmh_client_raise(const xcb_window_t window)
+{
+	if (ewmh_list_raise(&ewmh_stacking, window))
+	{
+		ewmh_list_publish(&ewmh_stacking, WM_ATOMS_NET_CLIENT_LIST_STACKING, 0);
 	}
+}
 
-	return NULL;
+void
+ewmh_active(const xcb_window_t window)
+{
+	xcb_change_property(connection, XCB_PROP_MODE_REPLACE, root,
+			wm_atoms[WM_ATOMS_NET_ACTIVE_WINDOW], XCB_ATOM_WINDOW, 32, 1, &window);
 }
 
-int32_t
-find_window(const xcb_window_t window_id)
+/*
+ * Pick the window title out of the _NET_WM_NAME and WM_NAME replies,
+ * preferring the former, and free both. Returns false if neither is set.
+ */
+bool
+name_from_replies(char *name,
+		const size_t size,
+		xcb_get_property_reply_t *net_reply,
+		xcb_get_property_reply_t *reply)
 {
-	for (uint32_t i = 0; i < windows_len; ++i)
+	xcb_get_property_reply_t *use = reply;
+
+	if (net_reply && xcb_get_property_value_length(net_reply) > 0)
 	{
-		if (windows[i].id == window_id)
-		{
-			return i;
-		}
+		use = net_reply;
+	}
+
+	const bool found = use && xcb_get_property_value_length(use) > 0;
+
+	if (found)
+	{
+		snprintf(name, size, "%.*s",
+				xcb_get_property_value_length(use),
+				(char *) xcb_get_property_value(use));
+	}
+	else
+	{
+		memset(name, '\0', size);
 	}
 
-	return -1;
+	free(net_reply);
+	free(reply);
+
+	return found;
+}
+
+int32_t
+find_window(const xcb_window_t window_id)
+{
+	return table_find(&table, window_id);
 }
 
 void
@@ -294,660 +681,3360 @@ setup_overview(void)
 			0, NULL);
 }
 
+bool
+rect_equal(const xcb_rectangle_t *a, const xcb_rectangle_t *b)
+{
+	return a->x == b->x && a->y == b->y &&
+		a->width == b->width && a->height == b->height;
+}
+
+bool
+rect_intersects(const xcb_rectangle_t *a, const xcb_rectangle_t *b)
+{
+	return a->x < b->x + b->width && b->x < a->x + a->width &&
+		a->y < b->y + b->height && b->y < a->y + a->height;
+}
+
+uint32_t
+monitor_at(const int32_t x, const int32_t y)
+{
+	return monitor_grid_find(&monitor_grid, x, y);
+}
+
+/*
+ * The monitor holding the centre of a managed window.
+ */
+uint32_t
+monitor_of(const int32_t index)
+{
+	const xcb_rectangle_t *rect = &table.windows[index].rect;
+
+	return monitor_at(rect->x + rect->width / 2, rect->y + rect->height / 2);
+}
+
 void
-setup_bar(void)
+monitors_index(void)
+{
+	xcb_rectangle_t rects[WM_MAX_MONITORS];
+
+	for (uint32_t i = 0; i < monitors_len; ++i)
+	{
+		rects[i] = monitors[i].rect;
+	}
+
+	monitor_grid_build(&monitor_grid, rects, monitors_len);
+
+	// Monitor edges are snap targets too, owned by no window
+	for (uint32_t i = 0; i < monitors_len; ++i)
+	{
+		snap_add(&snap, 0, &rects[i]);
+	}
+}
+
+/*
+ * Fit a bar to its monitor. The back-buffer is recreated at the new width
+ * and redrawn by the next update_bar().
+ */
+void
+bar_resize(wm_bar_t *bar, const xcb_rectangle_t *rect)
+{
+	if (bar->pixmap)
+	{
+		cairo_destroy(bar->cr);
+		cairo_surface_destroy(bar->surface);
+		xcb_free_pixmap(connection, bar->pixmap);
+	}
+
+	bar->width = rect->width;
+
+	bar->pixmap = xcb_generate_id(connection);
+	xcb_create_pixmap(connection, screen->root_depth,
+			bar->pixmap, bar->window,
+			bar->width, bar->height);
+
+	bar->surface = cairo_xcb_surface_create(connection,
+			bar->pixmap, visual_type,
+			bar->width, bar->height);
+	bar->cr = cairo_create(bar->surface);
+
+	xcb_configure_window(connection, bar->window,
+			XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y | XCB_CONFIG_WINDOW_WIDTH,
+			(uint32_t []) { rect->x, rect->y, bar->width });
+
+	bar->dirty = true;
+}
+
+void
+bar_create(wm_bar_t *bar, const xcb_rectangle_t *rect)
 {
-	bar = xcb_generate_id(connection);
+	memset(bar, 0, sizeof(wm_bar_t));
+	bar->height = CONFIG_BAR_HEIGHT;
+
+	bar->window = xcb_generate_id(connection);
 	xcb_create_window(connection,
 			XCB_COPY_FROM_PARENT,
-			bar,
+			bar->window,
 			root,
-			0, 0,
-			monitors[0].rect.width, bar_height,
+			rect->x, rect->y,
+			rect->width, bar->height,
 			CONFIG_BAR_BORDER,
 			XCB_WINDOW_CLASS_INPUT_OUTPUT,
 			screen->root_visual,
-			XCB_CW_BACK_PIXEL |
+			XCB_CW_BACK_PIXMAP |
 				XCB_CW_BORDER_PIXEL |
 				XCB_CW_OVERRIDE_REDIRECT |
 				XCB_CW_EVENT_MASK,
 			(uint32_t []) {
-				CONFIG_COLOR_BAR,
+				// Never cleared by the server, exposures are copied in
+				XCB_BACK_PIXMAP_NONE,
 				CONFIG_COLOR_BAR_BORDER,
 				true,
 				XCB_EVENT_MASK_BUTTON_PRESS |
 					XCB_EVENT_MASK_EXPOSURE
 			});
 
-	bar_gc = xcb_generate_id(connection);
-	xcb_create_gc(connection, bar_gc, bar,
+	bar->gc = xcb_generate_id(connection);
+	xcb_create_gc(connection, bar->gc, bar->window,
 			XCB_GC_FOREGROUND | XCB_GC_GRAPHICS_EXPOSURES,
 			(uint32_t [2]) {
 				[0] = CONFIG_COLOR_BAR,
 				[1] = 0
 			});
 
-	xcb_map_window(connection, bar);
-}
+	bar_resize(bar, rect);
 
-void
-update_bar(void)
-{
-	// Clear with rect
-	xcb_poly_fill_rectangle(connection,
-			bar, bar_gc,
-			1, (xcb_rectangle_t [1]) { {
-				.x = 0,
-				.y = 0,
-				.width = monitors[0].rect.width,
-				.height = bar_height
-			} });
-
-	int32_t index = find_window(current.id);
-	if (index == -1)
+	if (bar_visible)
 	{
-		return;
+		xcb_map_window(connection, bar->window);
 	}
-
-	//printf("text_render_draw: %s\n", windows[index].name);
-	text_render_draw(bar, windows[index].name, 5, 0, 
-			0.0, 0.0, 0.0, 1.0);
 }
 
 void
-toggle_bar(void)
+bar_destroy(wm_bar_t *bar)
 {
-	xcb_void_cookie_t (*xcb_toggle_window)(xcb_connection_t *, xcb_window_t) = xcb_unmap_window;
-
-	bar_visible = !bar_visible;
-
-	if (bar_visible)
+	if (!bar->window)
 	{
-		xcb_toggle_window = xcb_map_window;
+		return;
 	}
 
-	xcb_toggle_window(connection, bar);
-	update_bar();
-}
-
-xcb_cursor_t
-cursor_get(const uint32_t cursor_id)
-{
-	xcb_font_t cursor_font = xcb_generate_id(connection);
-	xcb_open_font(connection, cursor_font, 6, "cursor");
+	cairo_destroy(bar->cr);
+	cairo_surface_destroy(bar->surface);
 
-	xcb_cursor_t cursor = xcb_generate_id(connection);
-	xcb_create_glyph_cursor(connection,
-			cursor,
-			cursor_font,
-			cursor_font,
-			cursor_id,
-			cursor_id + 1,
-			0x3232, 0x3232, 0x3232, 0xeeee, 0xeeee, 0xeeec);
+	xcb_free_gc(connection, bar->gc);
+	xcb_free_pixmap(connection, bar->pixmap);
+	xcb_destroy_window(connection, bar->window);
 
-	return cursor;
+	memset(bar, 0, sizeof(wm_bar_t));
 }
 
 void
-cursor_set(const xcb_cursor_t cursor, const xcb_window_t window)
+setup_bar(void)
 {
-	xcb_change_window_attributes(connection, window,
-			XCB_CW_CURSOR,
-			(uint32_t []) { cursor });
+	for (uint32_t i = 0; i < monitors_len; ++i)
+	{
+		bar_create(&monitors[i].bar, &monitors[i].rect);
+	}
 }
 
 void
-cursor_free(xcb_cursor_t cursor)
+destroy_bar(void)
 {
-	xcb_free_cursor(connection, cursor);
+	for (uint32_t i = 0; i < monitors_len; ++i)
+	{
+		bar_destroy(&monitors[i].bar);
+	}
 }
 
 void
-cursor_change(const xcb_window_t window, const uint32_t cursor_id)
+bar_present(const wm_bar_t *bar)
 {
-	xcb_cursor_t cursor = cursor_get(cursor_id);
-	cursor_set(cursor, window);
-	cursor_free(cursor);
+	xcb_copy_area(connection, bar->pixmap, bar->window, bar->gc,
+			0, 0, 0, 0,
+			bar->width, bar->height);
 }
 
+/*
+ * Redraw the bars, but only those whose content differs from what their
+ * back-buffer already holds. The focused title shows on the bar of the
+ * monitor the focused window is on.
+ */
 void
-update_window_title(const xcb_window_t window)
+update_bar(void)
 {
-	int32_t index = find_window(window);
-	if (index == -1)
+	if (!bar_visible)
 	{
 		return;
 	}
 
-	strcpy(windows[index].name, get_name(window));
-}
+	const int32_t index = find_window(current.id);
+	const uint32_t focused = (index != -1) ? table.windows[index].monitor : 0;
 
-xcb_window_t
-frame_find_child(const xcb_window_t frame)
-{
-	for (uint32_t i = 0; i < windows_len; ++i)
+	for (uint32_t i = 0; i < monitors_len; ++i)
 	{
-		if (windows[i].frame == frame)
+		wm_bar_t *bar = &monitors[i].bar;
+		char title[sizeof(bar->title)];
+
+		snprintf(title, sizeof(title), "%u %s", monitors[i].workspace + 1,
+				(index != -1 && i == focused) ? table.windows[index].name : "");
+
+		if (!bar->dirty && strcmp(bar->title, title) == 0 &&
+				strcmp(bar->status, status_text) == 0)
 		{
-			return windows[i].id;
+			continue;
 		}
-	}
 
-	return 0;
-}
+		snprintf(bar->title, sizeof(bar->title), "%s", title);
+		snprintf(bar->status, sizeof(bar->status), "%s", status_text);
+		bar->dirty = false;
 
-xcb_window_t
-child_find_frame(const xcb_window_t child)
-{
-	for (uint32_t i = 0; i < windows_len; ++i)
-	{
-		if (windows[i].id == child)
+		// Compose the whole frame off-screen
+		text_render_color(bar->cr, CONFIG_COLOR_BAR);
+		cairo_paint(bar->cr);
+
+		text_render_draw(bar->cr, bar->title, 5, 0, CONFIG_COLOR_BAR_TEXT);
+
+		if (bar->status[0] != '\0')
 		{
-			return windows[i].frame;
+			text_render_draw(bar->cr, bar->status,
+					bar->width - text_render_width(bar->status) - 5, 0,
+					CONFIG_COLOR_BAR_TEXT);
 		}
-	}
 
-	return 0;
+		cairo_surface_flush(bar->surface);
+		bar_present(bar);
+	}
 }
 
 void
-update_current(const xcb_window_t frame)
+bar_dirty(void)
 {
-	const xcb_window_t child = frame_find_child(frame);
-	if (child == 0)
+	for (uint32_t i = 0; i < monitors_len; ++i)
 	{
-		return;
+		monitors[i].bar.dirty = true;
 	}
+}
 
-	set_border(current.frame, false);
-
-	current.frame = frame;
-	current.id = child;
+void
+toggle_bar(void)
+{
+	xcb_void_cookie_t (*xcb_toggle_window)(xcb_connection_t *, xcb_window_t) = xcb_unmap_window;
+
+	bar_visible = !bar_visible;
+	bar_dirty();
+
+	if (bar_visible)
+	{
+		xcb_toggle_window = xcb_map_window;
+	}
+
+	// The bar's strip is free space or not depending on its visibility
+	for (uint32_t i = 0; i < monitors_len; ++i)
+	{
+		xcb_toggle_window(connection, monitors[i].bar.window);
+		monitors[i].place.dirty = true;
+		monitors[i].layout_dirty = true;
+	}
 
-	set_border(current.frame, true);
-	set_focus(current.frame);
+	update_bar();
 }
 
+/*
+ * Create every cursor the WM uses in one batch, opening the cursor font
+ * only for the duration.
+ */
 void
-frame_update_size(const xcb_window_t frame,
-		const uint32_t width,
-		const uint32_t height)
+setup_cursors(void)
 {
-	const xcb_window_t child_win = frame_find_child(frame);
-	if (child_win == 0)
+	static const uint16_t glyphs[WM_CURSOR_ALL] = {
+		[WM_CURSOR_NORMAL] = XC_left_ptr,
+		[WM_CURSOR_MOVE] = XC_fleur,
+		[WM_CURSOR_RESIZE] = XC_sizing,
+		[WM_CURSOR_TOP] = XC_top_side,
+		[WM_CURSOR_BOTTOM] = XC_bottom_side,
+		[WM_CURSOR_LEFT] = XC_left_side,
+		[WM_CURSOR_RIGHT] = XC_right_side,
+		[WM_CURSOR_TOP_LEFT] = XC_top_left_corner,
+		[WM_CURSOR_TOP_RIGHT] = XC_top_right_corner,
+		[WM_CURSOR_BOTTOM_LEFT] = XC_bottom_left_corner,
+		[WM_CURSOR_BOTTOM_RIGHT] = XC_bottom_right_corner
+	};
+
+	xcb_font_t cursor_font = xcb_generate_id(connection);
+	xcb_open_font(connection, cursor_font, 6, "cursor");
+
+	for (uint32_t i = 0; i < WM_CURSOR_ALL; ++i)
 	{
-		return;
+		cursors[i] = xcb_generate_id(connection);
+		xcb_create_glyph_cursor(connection,
+				cursors[i],
+				cursor_font,
+				cursor_font,
+				glyphs[i],
+				glyphs[i] + 1,
+				0x3232, 0x3232, 0x3232, 0xeeee, 0xeeee, 0xeeec);
 	}
 
-	xcb_configure_window(connection,
-			frame,
-			XCB_CONFIG_WINDOW_WIDTH |
-			XCB_CONFIG_WINDOW_HEIGHT,
-			(uint32_t []) {
-				width, height
-			});
+	xcb_close_font(connection, cursor_font);
+}
 
-	xcb_configure_window(connection,
-			child_win,
-			XCB_CONFIG_WINDOW_WIDTH |
-			XCB_CONFIG_WINDOW_HEIGHT,
-			(uint32_t []) {
-				width, height - CONFIG_FRAME_BAR
-			});
+void
+cursor_set(const uint32_t cursor, const xcb_window_t window)
+{
+	xcb_change_window_attributes(connection, window,
+			XCB_CW_CURSOR,
+			(uint32_t []) { cursors[cursor] });
+}
+
+void
+destroy_cursors(void)
+{
+	for (uint32_t i = 0; i < WM_CURSOR_ALL; ++i)
+	{
+		xcb_free_cursor(connection, cursors[i]);
+	}
+}
 
-	// Clear old render
-	xcb_gcontext_t frame_gc = xcb_generate_id(connection);
+int32_t
+find_frame(const xcb_window_t frame)
+{
+	return table_find_frame(&table, frame);
+}
 
-	xcb_create_gc(connection, frame_gc, frame,
-			XCB_GC_FOREGROUND | XCB_GC_GRAPHICS_EXPOSURES,
+/*
+ * Render the focused and unfocused title strips of a frame into pixmaps,
+ * which become the frame's background so the server repaints exposures
+ * without the WM. Nothing is redrawn unless the title changed or the
+ * frame crossed into another width bucket. Returns true if the pixmaps
+ * were replaced and have to be applied again.
+ */
+bool
+frame_decor_render(const int32_t index)
+{
+	wm_window_t *window = &table.windows[index];
+	const uint16_t width = (window->rect.width + CONFIG_FRAME_BUCKET - 1) /
+		CONFIG_FRAME_BUCKET * CONFIG_FRAME_BUCKET;
+	static const uint32_t back[2] = {
+		CONFIG_COLOR_FRAME_BACK_UNFOCUS,
+		CONFIG_COLOR_FRAME_BACK_FOCUS
+	};
+	static const uint32_t text[2] = {
+		CONFIG_COLOR_FRAME_TEXT_UNFOCUS,
+		CONFIG_COLOR_FRAME_TEXT_FOCUS
+	};
+
+	if (window->decor[0] && window->decor_width == width)
+	{
+		return false;
+	}
+
+	for (uint32_t focus = 0; focus < 2; ++focus)
+	{
+		if (window->decor[focus])
+		{
+			xcb_free_pixmap(connection, window->decor[focus]);
+		}
+
+		window->decor[focus] = xcb_generate_id(connection);
+		xcb_create_pixmap(connection, screen->root_depth,
+				window->decor[focus], root,
+				width, CONFIG_FRAME_BAR);
+
+		cairo_surface_t *surface = cairo_xcb_surface_create(connection,
+				window->decor[focus], visual_type,
+				width, CONFIG_FRAME_BAR);
+		cairo_t *cr = cairo_create(surface);
+
+		text_render_color(cr, back[focus]);
+		cairo_paint(cr);
+
+		if (window->name[0] != '\0')
+		{
+			text_render_draw(cr, window->name, 5, 0, text[focus]);
+		}
+
+		cairo_destroy(cr);
+		cairo_surface_flush(surface);
+		cairo_surface_destroy(surface);
+	}
+
+	window->decor_width = width;
+
+	return true;
+}
+
+/*
+ * Switch a frame to its focused or unfocused look: one attribute change
+ * plus a clear so the title strip is repainted from the new pixmap.
+ */
+void
+frame_decor_apply(const int32_t index, const bool focus)
+{
+	const wm_window_t *window = &table.windows[index];
+
+	xcb_change_window_attributes(connection,
+			window->frame,
+			XCB_CW_BACK_PIXMAP | XCB_CW_BORDER_PIXEL,
 			(uint32_t [2]) {
-				[0] = CONFIG_COLOR_FRAME_BACK_FOCUS,
-				[1] = 0
+				window->decor[focus],
+				(focus) ? CONFIG_COLOR_FRAME_BORDER_FOCUS : CONFIG_COLOR_FRAME_BORDER_UNFOCUS
 			});
 
-	xcb_poly_fill_rectangle(connection,
-			frame, frame_gc,
-			1, (xcb_rectangle_t [1]) { {
-				.x = 0,
-				.y = 0,
-				.width = width,
-				.height = height
-			} });
+	xcb_clear_area(connection, 0, window->frame,
+			0, 0, window->rect.width, CONFIG_FRAME_BAR);
+}
+
+// Force a re-render, e.g. after the title changed
+void
+frame_decor_invalidate(const int32_t index)
+{
+	table.windows[index].decor_width = 0;
 
-	xcb_free_gc(connection, frame_gc);
+	if (frame_decor_render(index))
+	{
+		frame_decor_apply(index, current.frame == table.windows[index].frame);
+	}
 }
 
 void
-new_window(xcb_generic_event_t *event)
+frame_set_focus(const xcb_window_t frame, const bool focus)
 {
-	xcb_map_request_event_t *e = (xcb_map_request_event_t *) event;
+	const int32_t index = find_frame(frame);
+	if (index == -1)
+	{
+		return;
+	}
 
-	printf("Map request\n");
+	frame_decor_apply(index, focus);
+}
 
-	xcb_window_t frame = xcb_generate_id(connection);
-	xcb_get_geometry_reply_t *win_geom = xcb_get_geometry_reply(connection, xcb_get_geometry(connection, e->window), NULL);
+/*
+ * Ask for the title of a window whose name changed. The replies are only
+ * read by title_collect() once the event batch is drained, so a burst of
+ * changes costs one round trip, and each window is asked once per batch.
+ */
+void
+title_request(const xcb_window_t window)
+{
+	const int32_t index = find_window(window);
+	if (index == -1 || table.windows[index].title_pending)
+	{
+		return;
+	}
 
-	xcb_create_window(connection,
-			0,
-			frame,
-			root,
-			0, 0,
-			win_geom->width, win_geom->height + CONFIG_FRAME_BAR,
-			2,
-			XCB_WINDOW_CLASS_INPUT_OUTPUT,
-			screen->root_visual,
-				XCB_CW_BACK_PIXEL |
-				XCB_CW_BORDER_PIXEL |
-				XCB_CW_OVERRIDE_REDIRECT |
-				XCB_CW_EVENT_MASK,
-			(uint32_t []) {
-				CONFIG_COLOR_FRAME_BACK_FOCUS,
-				CONFIG_COLOR_FRAME_BORDER_FOCUS,
-				true,
-				XCB_EVENT_MASK_BUTTON_PRESS |
-					XCB_EVENT_MASK_EXPOSURE |
-					XCB_EVENT_MASK_ENTER_WINDOW | XCB_EVENT_MASK_SUBSTRUCTURE_REDIRECT}
-			);
+	table.windows[index].title_cookies[0] = get_property(window,
+			wm_atoms[WM_ATOMS_NET_WM_NAME], 64);
+	table.windows[index].title_cookies[1] = get_property(window,
+			XCB_ATOM_WM_NAME, 64);
+	table.windows[index].title_pending = true;
+	++titles_pending;
+}
 
-	xcb_change_window_attributes_checked(connection,
-			e->window,
-			XCB_CW_EVENT_MASK,
-			(uint32_t [1]) {XCB_EVENT_MASK_PROPERTY_CHANGE | XCB_EVENT_MASK_SUBSTRUCTURE_REDIRECT});
+void
+title_discard(wm_window_t *window)
+{
+	if (!window->title_pending)
+	{
+		return;
+	}
+
+	xcb_discard_reply(connection, window->title_cookies[0].sequence);
+	xcb_discard_reply(connection, window->title_cookies[1].sequence);
+	window->title_pending = false;
+	--titles_pending;
+}
+
+/*
+ * Read the titles requested during the batch, the first wait flushes
+ * them all, and redraw what changed.
+ */
+void
+title_collect(void)
+{
+	for (uint32_t i = 0; i < table.len && titles_pending > 0; ++i)
+	{
+		wm_window_t *window = &table.windows[i];
 
-	xcb_reparent_window(connection, e->window, frame, 0, CONFIG_FRAME_BAR);
+		if (!window->id || !window->title_pending)
+		{
+			continue;
+		}
 
-	printf("New window for: %d | frame: %d\n", e->window, frame);
+		window->title_pending = false;
+		--titles_pending;
 
-	// Add to list
-	windows[windows_len].id = e->window;
-	windows[windows_len].frame = frame;
-	strcpy(windows[windows_len].name, get_name(e->window));
-	windows[windows_len].visible = true;
+		name_from_replies(window->name, sizeof(window->name),
+				STATS_REPLY(xcb_get_property_reply(connection, window->title_cookies[0], NULL)),
+				STATS_REPLY(xcb_get_property_reply(connection, window->title_cookies[1], NULL)));
 
-	++windows_len;
+		frame_decor_invalidate(i);
+		ipc_event(&ipc, "title 0x%x %s\n", window->id, window->name);
+	}
 
-	update_current(frame);
 	update_bar();
+}
 
-	printf("Mapping window: %s\n", get_name(e->window));
+xcb_window_t
+frame_find_child(const xcb_window_t frame)
+{
+	const int32_t index = find_frame(frame);
 
-	xcb_map_window(connection, e->window);
-	xcb_map_window(connection, frame);
-	xcb_flush(connection);
+	return (index == -1) ? 0 : table.windows[index].id;
+}
+
+xcb_rectangle_t
+window_outer(const wm_window_t *window)
+{
+	return (xcb_rectangle_t) {
+		.x = window->rect.x,
+		.y = window->rect.y,
+		.width = window->rect.width + 2 * window->border,
+		.height = window->rect.height + 2 * window->border
+	};
 }
 
 void
-property_notify(xcb_generic_event_t *event)
+workspace_link(const int32_t index, const uint32_t monitor, const uint32_t workspace)
 {
-	xcb_property_notify_event_t *e = (xcb_property_notify_event_t *) event;
+	wm_window_t *window = &table.windows[index];
+	wm_workspace_t *list = &monitors[monitor].workspaces[workspace];
 
-	//printf("Atom: %d == %d\n", e->atom, XCB_ATOM_WM_NAME);
+	window->monitor = monitor;
+	window->workspace = workspace;
+	window->workspace_prev = -1;
+	window->workspace_next = (list->len) ? list->head : -1;
 
-	if (e->atom == XCB_ATOM_WM_NAME)
-	{	// Window name changed
-		update_window_title(e->window);
-		update_bar();
+	if (list->len)
+	{
+		table.windows[list->head].workspace_prev = index;
 	}
 
-	xcb_flush(connection);
+	list->head = index;
+	++list->len;
 }
 
 void
-frame_kill(const xcb_window_t frame)
+workspace_unlink(const int32_t index)
 {
-	send_event(frame_find_child(frame), wm_atoms[WM_ATOMS_DELETE]);
-	xcb_unmap_window(connection, frame);
+	const wm_window_t *window = &table.windows[index];
+	wm_workspace_t *list = &monitors[window->monitor].workspaces[window->workspace];
 
-	current.id = root;
-	current.frame = root;
-	memset(current.name, '\0', sizeof(current.name));
-	current.visible = false;
+	if (window->workspace_prev != -1)
+	{
+		table.windows[window->workspace_prev].workspace_next = window->workspace_next;
+	}
+	else
+	{
+		list->head = window->workspace_next;
+	}
+
+	if (window->workspace_next != -1)
+	{
+		table.windows[window->workspace_next].workspace_prev = window->workspace_prev;
+	}
+
+	--list->len;
+}
+
+/*
+ * Outer rectangles of the windows taking up free space on a monitor, the
+ * members of its shown workspace, leaving out skip and the window being
+ * moved. A window hanging over from a neighbour is not avoided. rects
+ * needs room for the workspace's length.
+ */
+uint32_t
+place_windows(const uint32_t monitor, const int32_t skip, xcb_rectangle_t *rects)
+{
+	const wm_workspace_t *list = &monitors[monitor].workspaces[monitors[monitor].workspace];
+	uint32_t len = 0;
+
+	for (int32_t i = (list->len) ? list->head : -1; i != -1; i = table.windows[i].workspace_next)
+	{
+		const wm_window_t *window = &table.windows[i];
+
+		if (i != skip && !(drag.mode == WM_DRAG_MOVE && drag.frame == window->frame))
+		{
+			rects[len++] = window_outer(window);
+		}
+	}
+
+	return len;
 }
 
+/*
+ * Add or drop a window in the snap index and the free space of the
+ * monitors it covers. A dropped window's space goes back to the free
+ * lists right away; every geometry change drops the window first and adds
+ * it again at its new place. The window being moved is kept out until the
+ * button is released, and windows of hidden workspaces are kept out
+ * altogether. A window added on another monitor joins the workspace shown
+ * there.
+ */
 void
-key_press(xcb_generic_event_t *event)
+window_track(const int32_t index, const bool add)
 {
-	xcb_key_press_event_t *e = (xcb_key_press_event_t *) event;
+	const wm_window_t *window = &table.windows[index];
+	const xcb_rectangle_t outer = window_outer(window);
 
-	xcb_keysym_t keysym = xcb_key_symbols_get_keysym(syms, e->detail, 0);
+	if (!window->visible || (drag.mode == WM_DRAG_MOVE && drag.frame == window->frame))
+	{
+		return;
+	}
 
-	//printf("keysym got: %d | q: %d\n", keysym, XK_q);
-	switch (keysym)
+	if (add)
 	{
-	case XK_e:	// Exit window manager
-		//printf("state: %d\n", e->state);
-		if (e->state == (PRIMARY_MOD_KEY | XCB_MOD_MASK_SHIFT))
+		const uint32_t monitor = monitor_of(index);
+
+		if (monitor != window->monitor)
 		{
-			printf("Closing wm\n");
-			running = false;
+			monitors[window->monitor].layout_dirty = true;
+			monitors[monitor].layout_dirty = true;
+			workspace_unlink(index);
+			workspace_link(index, monitor, monitors[monitor].workspace);
 		}
-		break;
-	case XK_q:	// Kill window
-		if (e->state == (PRIMARY_MOD_KEY | XCB_MOD_MASK_SHIFT))
+
+		snap_add(&snap, window->frame, &outer);
+	}
+	else
+	{
+		snap_remove(&snap, window->frame, &outer);
+	}
+
+	for (uint32_t i = 0; i < monitors_len; ++i)
+	{
+		wm_place_t *place = &monitors[i].place;
+
+		if (!rect_intersects(&monitors[i].rect, &outer) || place->dirty)
 		{
-			frame_kill(e->child);
-			update_bar();
-			//xcb_kill_client(connection, window);
+			continue;
+		}
+
+		if (add)
+		{
+			place_occupy(place, &outer);
+		}
+		else
+		{
+			const wm_workspace_t *list = &monitors[i].workspaces[monitors[i].workspace];
+			xcb_rectangle_t rects[list->len + 1];
+
+			place_release(place, &outer, rects, place_windows(i, index, rects));
 		}
-		break;
-	case XK_a:	// Raise window
-		update_current(e->child);
-		values[0] = XCB_STACK_MODE_ABOVE;
-		xcb_configure_window(connection,
-				e->child,
-				XCB_CONFIG_WINDOW_STACK_MODE,
-				values);
-		update_bar();
-		break;
-	case XK_d:	// dmenu
-		spawn("dmenu_run");
-		break;
-	case XK_b:
-		toggle_bar();
-		break;
 	}
+}
 
-	xcb_flush(connection);
+/*
+ * The part of a monitor windows can use, below its bar.
+ */
+xcb_rectangle_t
+monitor_area(const uint32_t monitor)
+{
+	xcb_rectangle_t area = monitors[monitor].rect;
+
+	if (bar_visible)
+	{
+		area.y += CONFIG_BAR_HEIGHT;
+		area.height -= CONFIG_BAR_HEIGHT;
+	}
+
+	return area;
 }
 
+/*
+ * Pick a spot for a new window of the given outer size on a monitor: the
+ * largest free area it fits in, or the next cascade step.
+ */
 void
-button_press(xcb_generic_event_t *event)
+window_place(const uint32_t monitor,
+		const uint16_t width,
+		const uint16_t height,
+		int16_t *x,
+		int16_t *y)
 {
-	xcb_button_press_event_t *e = (xcb_button_press_event_t *) event;
+	wm_place_t *place = &monitors[monitor].place;
 
-	// Ignore it (background)
-	if (e->child == 0)
+	if (place->dirty)
+	{
+		const xcb_rectangle_t area = monitor_area(monitor);
+		const uint32_t cascade = place->cascade;
+
+		const wm_workspace_t *list = &monitors[monitor].workspaces[monitors[monitor].workspace];
+		xcb_rectangle_t rects[list->len + 1];
+		const uint32_t len = place_windows(monitor, -1, rects);
+
+		place_init(place, &area);
+		place->cascade = cascade;
+
+		for (uint32_t i = 0; i < len; ++i)
+		{
+			place_occupy(place, &rects[i]);
+		}
+	}
+
+	if (!place_find(place, width, height, x, y))
+	{
+		place_cascade(place, width, height, x, y);
+	}
+}
+
+
+/*
+ * Configure a frame and mirror the change into the window cache, so that
+ * nothing has to ask the server for geometry the WM itself has set.
+ * Values follow the X protocol order of the mask bits.
+ */
+void
+frame_configure(const int32_t index,
+		const uint16_t mask,
+		const uint32_t *values)
+{
+	wm_window_t *window = &table.windows[index];
+	const bool geometry = mask & (XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y |
+			XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT |
+			XCB_CONFIG_WINDOW_BORDER_WIDTH);
+	uint32_t i = 0;
+
+	if (geometry)
+	{
+		window_track(index, false);
+	}
+
+	if (mask & XCB_CONFIG_WINDOW_X) window->rect.x = values[i++];
+	if (mask & XCB_CONFIG_WINDOW_Y) window->rect.y = values[i++];
+	if (mask & XCB_CONFIG_WINDOW_WIDTH) window->rect.width = values[i++];
+	if (mask & XCB_CONFIG_WINDOW_HEIGHT) window->rect.height = values[i++];
+	if (mask & XCB_CONFIG_WINDOW_BORDER_WIDTH) window->border = values[i++];
+	if (mask & XCB_CONFIG_WINDOW_SIBLING) ++i;
+	if (mask & XCB_CONFIG_WINDOW_STACK_MODE && values[i] == XCB_STACK_MODE_ABOVE)
+	{
+		window->stack = ++stack_top;
+		ewmh_client_raise(window->id);
+	}
+
+	if (geometry)
+	{
+		window_track(index, true);
+	}
+
+	xcb_configure_window(connection, window->frame, mask, values);
+}
+
+void
+frame_raise(const xcb_window_t frame)
+{
+	const int32_t index = find_frame(frame);
+	if (index == -1)
+	{
+		return;
+	}
+
+	frame_configure(index,
+			XCB_CONFIG_WINDOW_STACK_MODE,
+			(uint32_t []) { XCB_STACK_MODE_ABOVE });
+}
+
+xcb_window_t
+child_find_frame(const xcb_window_t child)
+{
+	const int32_t index = find_window(child);
+
+	return (index == -1) ? 0 : table.windows[index].frame;
+}
+
+/*
+ * Focus frame in answer to an event at time. Enters, clicks and keys on
+ * the frame that already has the focus change nothing.
+ */
+void
+update_current(const xcb_window_t frame, const xcb_timestamp_t time)
+{
+	const xcb_window_t child = frame_find_child(frame);
+	if (child == 0 || current.frame == frame)
+	{
+		return;
+	}
+
+	ipc_event(&ipc, "focus 0x%x\n", child);
+	ewmh_active(child);
+
+	frame_set_focus(current.frame, false);
+
+	current.frame = frame;
+	current.id = child;
+
+	frame_set_focus(current.frame, true);
+
+	// ICCCM input models: clients that set the input hint to false take
+	// the focus themselves on WM_TAKE_FOCUS, or never take it at all
+	const int32_t index = find_window(child);
+	if (table.windows[index].input)
+	{
+		set_focus(current.frame, time);
+	}
+
+	// ICCCM forbids CurrentTime here, before any event there is no other
+	if ((table.windows[index].protocols & WM_PROTOCOL_TAKE_FOCUS) && time != XCB_CURRENT_TIME)
+	{
+		send_event(child, wm_atoms[WM_ATOMS_TAKEFOCUS], time);
+	}
+}
+
+void
+frame_update_size(const xcb_window_t frame,
+		const uint32_t width,
+		const uint32_t height)
+{
+	const int32_t index = find_frame(frame);
+	if (index == -1)
+	{
+		return;
+	}
+
+	const xcb_window_t child_win = table.windows[index].id;
+
+	frame_configure(index,
+			XCB_CONFIG_WINDOW_WIDTH |
+			XCB_CONFIG_WINDOW_HEIGHT,
+			(uint32_t []) {
+				width, height
+			});
+
+	xcb_configure_window(connection,
+			child_win,
+			XCB_CONFIG_WINDOW_WIDTH |
+			XCB_CONFIG_WINDOW_HEIGHT,
+			(uint32_t []) {
+				width, height - CONFIG_FRAME_BAR
+			});
+
+	// The server repaints from the background pixmap on its own
+	if (frame_decor_render(index))
+	{
+		frame_decor_apply(index, current.frame == frame);
+	}
+}
+
+/*
+ * Move and resize a frame to rect, sending only the parts that differ
+ * from the cached geometry.
+ */
+void
+frame_apply(const int32_t index, const xcb_rectangle_t *rect)
+{
+	const wm_window_t *window = &table.windows[index];
+
+	if (rect->x != window->rect.x || rect->y != window->rect.y)
+	{
+		frame_configure(index,
+				XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y,
+				(uint32_t []) { rect->x, rect->y });
+	}
+
+	if (rect->width != window->rect.width || rect->height != window->rect.height)
+	{
+		frame_update_size(window->frame, rect->width, rect->height);
+	}
+}
+
+void
+layout_mark(const int32_t index)
+{
+	monitors[table.windows[index].monitor].layout_dirty = true;
+}
+
+/*
+ * Re-tile the monitors marked dirty since the last wakeup, all in the
+ * same flush. The layout of a monitor is recomputed from scratch but only
+ * windows whose geometry actually changes are configured.
+ */
+void
+layout_flush(void)
+{
+	for (uint32_t m = 0; m < monitors_len; ++m)
+	{
+		if (!monitors[m].layout_dirty)
+		{
+			continue;
+		}
+
+		monitors[m].layout_dirty = false;
+
+		if (monitors[m].layout == LAYOUT_FLOATING)
+		{
+			continue;
+		}
+
+		// Tiles move together, the free space is rebuilt once if needed
+		monitors[m].place.dirty = true;
+
+		// Dialogs keep floating above the tiles
+		const wm_workspace_t *list = &monitors[m].workspaces[monitors[m].workspace];
+		int32_t members[list->len + 1];
+		uint32_t count = 0;
+
+		for (int32_t i = (list->len) ? list->head : -1; i != -1; i = table.windows[i].workspace_next)
+		{
+			const wm_window_t *window = &table.windows[i];
+
+			if (window->transient_for || window->fullscreen)
+			{
+				continue;
+			}
+
+			uint32_t j = count++;
+
+			while (j > 0 && table.windows[members[j - 1]].order > window->order)
+			{
+				members[j] = members[j - 1];
+				--j;
+			}
+
+			members[j] = i;
+		}
+
+		const xcb_rectangle_t area = monitor_area(m);
+		xcb_rectangle_t tiles[count + 1];
+
+		layout_arrange(monitors[m].layout, &area, count, CONFIG_MASTER_PERCENT, tiles);
+
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			const uint16_t border = table.windows[members[i]].border;
+			const xcb_rectangle_t rect = {
+				.x = tiles[i].x,
+				.y = tiles[i].y,
+				.width = (tiles[i].width > 2 * border + MIN_WIDTH) ?
+					tiles[i].width - 2 * border : MIN_WIDTH,
+				.height = (tiles[i].height > 2 * border + MIN_HEIGHT) ?
+					tiles[i].height - 2 * border : MIN_HEIGHT
+			};
+
+			frame_apply(members[i], &rect);
+		}
+	}
+}
+
+/*
+ * Map or unmap a window and its frame for a workspace change. The client
+ * is mapped while its frame is still unmapped, so it never shows before
+ * it has been decorated, and its UnmapNotify is marked as the WM's own.
+ */
+void
+window_show(const int32_t index, const bool show)
+{
+	wm_window_t *window = &table.windows[index];
+
+	if (window->visible == show)
+	{
+		return;
+	}
+
+	if (show)
+	{
+		window->visible = true;
+		window_track(index, true);
+		xcb_map_window(connection, window->id);
+		xcb_map_window(connection, window->frame);
+	}
+	else
+	{
+		window_track(index, false);
+		window->visible = false;
+		++window->ignore_unmaps;
+		xcb_unmap_window(connection, window->frame);
+		xcb_unmap_window(connection, window->id);
+	}
+}
+
+void
+current_clear(void)
+{
+	if (current.id != root)
+	{
+		ewmh_active(XCB_NONE);
+	}
+
+	current.id = root;
+	current.frame = root;
+	memset(current.name, '\0', sizeof(current.name));
+	current.visible = false;
+}
+
+/*
+ * Show another workspace on a monitor. Only the members of the two
+ * workspaces are visited, the incoming ones are mapped before the
+ * outgoing ones are unmapped so the desktop never shows through, and no
+ * reply is waited for: the whole switch goes out in one flush.
+ */
+void
+workspace_switch(const uint32_t monitor, const uint32_t workspace)
+{
+	wm_monitor_t *m = &monitors[monitor];
+
+	if (workspace >= CONFIG_WORKSPACES || workspace == m->workspace)
+	{
+		return;
+	}
+
+	const wm_workspace_t *from = &m->workspaces[m->workspace];
+	const wm_workspace_t *to = &m->workspaces[workspace];
+	const int32_t focused = find_window(current.id);
+	xcb_window_t top = 0;
+	uint32_t top_stack = 0;
+
+	m->workspace = workspace;
+	m->layout_dirty = true;
+
+	// Every window comes or goes, one rebuild beats freeing them singly
+	m->place.dirty = true;
+
+	// A window shown off this monitor moves to the workspace there, so
+	// the next member is taken before it is shown
+	for (int32_t i = (to->len) ? to->head : -1, next; i != -1; i = next)
+	{
+		next = table.windows[i].workspace_next;
+
+		window_show(i, true);
+
+		if (table.windows[i].monitor == monitor && table.windows[i].stack > top_stack)
+		{
+			top = table.windows[i].frame;
+			top_stack = table.windows[i].stack;
+		}
+	}
+
+	for (int32_t i = (from->len) ? from->head : -1; i != -1; i = table.windows[i].workspace_next)
+	{
+		window_show(i, false);
+	}
+
+	if (top)
+	{
+		update_current(top, event_time);
+	}
+	else if (focused != -1 && !table.windows[focused].visible)
+	{
+		current_clear();
+	}
+
+	ipc_event(&ipc, "workspace %u %u\n", monitor, workspace + 1);
+	update_bar();
+}
+
+/*
+ * Move a window to another workspace of its monitor.
+ */
+void
+workspace_send(const int32_t index, const uint32_t workspace)
+{
+	const uint32_t monitor = table.windows[index].monitor;
+
+	if (workspace >= CONFIG_WORKSPACES || workspace == table.windows[index].workspace)
+	{
+		return;
+	}
+
+	monitors[monitor].layout_dirty = true;
+	workspace_unlink(index);
+	workspace_link(index, monitor, workspace);
+	window_show(index, workspace == monitors[monitor].workspace);
+
+	if (current.frame == table.windows[index].frame && !table.windows[index].visible)
+	{
+		current_clear();
+		update_bar();
+	}
+}
+
+/*
+ * Cover the monitor of a window with its client alone, title bar and
+ * border included, or put the frame back where it was.
+ */
+void
+window_fullscreen(const int32_t index, const bool fullscreen)
+{
+	wm_window_t *window = &table.windows[index];
+
+	if (window->fullscreen == fullscreen)
+	{
+		return;
+	}
+
+	window->fullscreen = fullscreen;
+
+	if (fullscreen)
+	{
+		const xcb_rectangle_t *area = &monitors[window->monitor].rect;
+
+		window->restore = window->rect;
+		window->restore_border = window->border;
+
+		frame_configure(index,
+				XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y |
+				XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT |
+				XCB_CONFIG_WINDOW_BORDER_WIDTH | XCB_CONFIG_WINDOW_STACK_MODE,
+				(uint32_t []) { area->x, area->y, area->width, area->height,
+					0, XCB_STACK_MODE_ABOVE });
+
+		xcb_configure_window(connection, window->id,
+				XCB_CONFIG_WINDOW_Y | XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT,
+				(uint32_t []) { 0, area->width, area->height });
+	}
+	else
+	{
+		const xcb_rectangle_t *rect = &window->restore;
+
+		frame_configure(index,
+				XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y |
+				XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT |
+				XCB_CONFIG_WINDOW_BORDER_WIDTH,
+				(uint32_t []) { rect->x, rect->y, rect->width, rect->height,
+					window->restore_border });
+
+		xcb_configure_window(connection, window->id,
+				XCB_CONFIG_WINDOW_Y | XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT,
+				(uint32_t []) { CONFIG_FRAME_BAR, rect->width, rect->height - CONFIG_FRAME_BAR });
+	}
+
+	xcb_change_property(connection, XCB_PROP_MODE_REPLACE, window->id,
+			wm_atoms[WM_ATOMS_NET_WM_STATE], XCB_ATOM_ATOM, 32, fullscreen,
+			&wm_atoms[WM_ATOMS_NET_WM_STATE_FULLSCREEN]);
+
+	layout_mark(index);
+}
+
+void
+adopt_request(wm_adopt_t *adopt, const xcb_window_t window)
+{
+	adopt->window = window;
+	adopt->mapped = false;
+	adopt->geometry = xcb_get_geometry(connection, window);
+	adopt->name = get_property(window, XCB_ATOM_WM_NAME, 64);
+	adopt->net_name = get_property(window, wm_atoms[WM_ATOMS_NET_WM_NAME], 64);
+	adopt->protocols = get_property(window, wm_atoms[WM_ATOMS_PROTOCOLS], 32);
+	adopt->normal_hints = get_property(window, XCB_ATOM_WM_NORMAL_HINTS, 18);
+	adopt->hints = get_property(window, XCB_ATOM_WM_HINTS, 9);
+	adopt->class = get_property(window, XCB_ATOM_WM_CLASS, 16);
+	adopt->transient = get_property(window, XCB_ATOM_WM_TRANSIENT_FOR, 1);
+	adopt->sync_counter = get_property(window, wm_atoms[WM_ATOMS_SYNC_REQUEST_COUNTER], 1);
+	adopt->net_state = get_property(window, wm_atoms[WM_ATOMS_NET_WM_STATE], 16);
+}
+
+/*
+ * Read the ICCCM properties of a new window into its table entry. Every
+ * reply is freed here. Returns whether the client asked to start
+ * fullscreen, the only _NET_WM_STATE honoured.
+ */
+bool
+adopt_properties(wm_window_t *window, const wm_adopt_t *adopt)
+{
+	xcb_get_property_reply_t *reply;
+	bool fullscreen = false;
+
+	name_from_replies(window->name, sizeof(window->name),
+			STATS_REPLY(xcb_get_property_reply(connection, adopt->net_name, NULL)),
+			STATS_REPLY(xcb_get_property_reply(connection, adopt->name, NULL)));
+
+	if ((reply = STATS_REPLY(xcb_get_property_reply(connection, adopt->protocols, NULL))))
+	{
+		const xcb_atom_t *atoms = xcb_get_property_value(reply);
+		const int32_t len = xcb_get_property_value_length(reply) / sizeof(xcb_atom_t);
+
+		for (int32_t i = 0; i < len; ++i)
+		{
+			if (atoms[i] == wm_atoms[WM_ATOMS_DELETE])
+			{
+				window->protocols |= WM_PROTOCOL_DELETE;
+			}
+			else if (atoms[i] == wm_atoms[WM_ATOMS_TAKEFOCUS])
+			{
+				window->protocols |= WM_PROTOCOL_TAKE_FOCUS;
+			}
+			else if (atoms[i] == wm_atoms[WM_ATOMS_SYNC_REQUEST])
+			{
+				window->protocols |= WM_PROTOCOL_SYNC_REQUEST;
+			}
+		}
+
+		free(reply);
+	}
+
+	// WM_SIZE_HINTS: flags, x, y, w, h, min w/h, max w/h, ...
+	if ((reply = STATS_REPLY(xcb_get_property_reply(connection, adopt->normal_hints, NULL))))
+	{
+		const uint32_t *hints = xcb_get_property_value(reply);
+
+		if (xcb_get_property_value_length(reply) >= 9 * 4)
+		{
+			if (hints[0] & (1 << 4))	// PMinSize
+			{
+				window->min_width = hints[5];
+				window->min_height = hints[6];
+			}
+
+			if (hints[0] & (1 << 5))	// PMaxSize
+			{
+				window->max_width = hints[7];
+				window->max_height = hints[8];
+			}
+		}
+
+		free(reply);
+	}
+
+	// WM_HINTS: flags, input, ...
+	window->input = true;
+	if ((reply = STATS_REPLY(xcb_get_property_reply(connection, adopt->hints, NULL))))
+	{
+		const uint32_t *hints = xcb_get_property_value(reply);
+
+		if (xcb_get_property_value_length(reply) >= 2 * 4)
+		{
+			if (hints[0] & (1 << 0))	// InputHint
+			{
+				window->input = hints[1];
+			}
+		}
+
+		free(reply);
+	}
+
+	// WM_CLASS: "instance\0class\0"
+	if ((reply = STATS_REPLY(xcb_get_property_reply(connection, adopt->class, NULL))))
+	{
+		const char *value = xcb_get_property_value(reply);
+		const int32_t len = xcb_get_property_value_length(reply);
+		const char *end = memchr(value, '\0', len);
+		const int32_t instance_len = (end) ? end - value : len;
+
+		snprintf(window->instance, sizeof(window->instance), "%.*s",
+				instance_len, value);
+
+		if (instance_len + 1 < len)
+		{
+			snprintf(window->class, sizeof(window->class), "%.*s",
+					len - instance_len - 1, value + instance_len + 1);
+		}
+
+		free(reply);
+	}
+
+	if ((reply = STATS_REPLY(xcb_get_property_reply(connection, adopt->transient, NULL))))
+	{
+		if (xcb_get_property_value_length(reply) >= 4)
+		{
+			window->transient_for = *(xcb_window_t *) xcb_get_property_value(reply);
+		}
+
+		free(reply);
+	}
+
+	if ((reply = STATS_REPLY(xcb_get_property_reply(connection, adopt->sync_counter, NULL))))
+	{
+		if (xcb_get_property_value_length(reply) >= 4)
+		{
+			window->sync_counter = *(uint32_t *) xcb_get_property_value(reply);
+		}
+
+		free(reply);
+	}
+
+	// Both halves and the server extension are needed for the protocol
+	if (!window->sync_counter || !sync_event_base)
+	{
+		window->protocols &= ~WM_PROTOCOL_SYNC_REQUEST;
+	}
+
+	if ((reply = STATS_REPLY(xcb_get_property_reply(connection, adopt->net_state, NULL))))
+	{
+		const xcb_atom_t *atoms = xcb_get_property_value(reply);
+		const int32_t len = xcb_get_property_value_length(reply) / sizeof(xcb_atom_t);
+
+		for (int32_t i = 0; i < len; ++i)
+		{
+			fullscreen |= atoms[i] == wm_atoms[WM_ATOMS_NET_WM_STATE_FULLSCREEN];
+		}
+
+		free(reply);
+	}
+
+	return fullscreen;
+}
+
+void
+adopt_discard(const wm_adopt_t *adopt)
+{
+	xcb_discard_reply(connection, adopt->name.sequence);
+	xcb_discard_reply(connection, adopt->net_name.sequence);
+	xcb_discard_reply(connection, adopt->protocols.sequence);
+	xcb_discard_reply(connection, adopt->normal_hints.sequence);
+	xcb_discard_reply(connection, adopt->hints.sequence);
+	xcb_discard_reply(connection, adopt->class.sequence);
+	xcb_discard_reply(connection, adopt->transient.sequence);
+	xcb_discard_reply(connection, adopt->sync_counter.sequence);
+	xcb_discard_reply(connection, adopt->net_state.sequence);
+}
+
+/*
+ * Collect the replies asked for by adopt_request(), then frame and map
+ * the window. Returns its table index, or -1 if it could not be managed.
+ */
+int32_t
+adopt_finish(const wm_adopt_t *adopt)
+{
+	xcb_get_geometry_reply_t *win_geom = STATS_REPLY(xcb_get_geometry_reply(connection,
+			adopt->geometry, NULL));
+
+	if (!win_geom)
+	{
+		adopt_discard(adopt);
+		return -1;
+	}
+
+	xcb_rectangle_t rect = {
+		.x = win_geom->x,
+		.y = win_geom->y,
+		.width = win_geom->width,
+		.height = win_geom->height + CONFIG_FRAME_BAR
+	};
+
+	// New windows open in free space on the focused monitor, windows
+	// found mapped at startup keep their place on screen
+	if (!adopt->mapped)
+	{
+		const int32_t focused = find_window(current.id);
+
+		window_place((focused != -1) ? table.windows[focused].monitor : 0,
+				rect.width + 2 * CONFIG_FRAME_BORDER,
+				rect.height + 2 * CONFIG_FRAME_BORDER,
+				&rect.x, &rect.y);
+	}
+
+	free(win_geom);
+
+	xcb_window_t frame = xcb_generate_id(connection);
+
+	const int32_t index = table_add(&table, adopt->window, frame);
+	if (index == -1)
+	{
+		adopt_discard(adopt);
+		return -1;
+	}
+
+	wm_window_t *window = &table.windows[index];
+
+	const bool fullscreen = adopt_properties(window, adopt);
+
+	xcb_create_window(connection,
+			0,
+			frame,
+			root,
+			rect.x, rect.y,
+			rect.width, rect.height,
+			CONFIG_FRAME_BORDER,
+			XCB_WINDOW_CLASS_INPUT_OUTPUT,
+			screen->root_visual,
+				XCB_CW_BACK_PIXEL |
+				XCB_CW_BORDER_PIXEL |
+				XCB_CW_OVERRIDE_REDIRECT |
+				XCB_CW_EVENT_MASK,
+			(uint32_t []) {
+				CONFIG_COLOR_FRAME_BACK_FOCUS,
+				CONFIG_COLOR_FRAME_BORDER_FOCUS,
+				true,
+				XCB_EVENT_MASK_BUTTON_PRESS |
+					XCB_EVENT_MASK_EXPOSURE |
+					XCB_EVENT_MASK_ENTER_WINDOW |
+					XCB_EVENT_MASK_SUBSTRUCTURE_REDIRECT |
+					XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY}
+			);
+
+	xcb_change_window_attributes(connection,
+			adopt->window,
+			XCB_CW_EVENT_MASK,
+			(uint32_t [1]) {XCB_EVENT_MASK_PROPERTY_CHANGE | XCB_EVENT_MASK_SUBSTRUCTURE_REDIRECT});
+
+	xcb_reparent_window(connection, adopt->window, frame, 0, CONFIG_FRAME_BAR);
+
+	// Reparenting a mapped window unmaps it first, which is not a withdraw
+	if (adopt->mapped)
+	{
+		++window->ignore_unmaps;
+	}
+
+	printf("New window for: %d | frame: %d\n", adopt->window, frame);
+
+	window->visible = true;
+	window->rect = rect;
+	window->border = CONFIG_FRAME_BORDER;
+	window->stack = ++stack_top;
+	window->order = ++order_top;
+	const uint32_t monitor = monitor_of(index);
+	workspace_link(index, monitor, monitors[monitor].workspace);
+	window_track(index, true);
+	layout_mark(index);
+
+	frame_decor_render(index);
+
+	// At startup the caller focuses once, after every window is adopted
+	if (adopt->mapped)
+	{
+		frame_decor_apply(index, false);
+	}
+	else
+	{
+		update_current(frame, event_time);
+		update_bar();
+	}
+
+	printf("Mapping window: %s (%s)\n", window->name, window->class);
+
+	ewmh_client_add(adopt->window);
+
+	if (fullscreen)
+	{
+		window_fullscreen(index, true);
+	}
+
+	xcb_map_window(connection, adopt->window);
+	xcb_map_window(connection, frame);
+
+	ipc_event(&ipc, "map 0x%x\n", adopt->window);
+
+	return index;
+}
+
+void
+new_window(xcb_generic_event_t *event)
+{
+	xcb_map_request_event_t *e = (xcb_map_request_event_t *) event;
+	wm_adopt_t adopt;
+
+	printf("Map request\n");
+
+	// Already managed, just let it map inside its frame
+	if (find_window(e->window) != -1)
+	{
+		xcb_map_window(connection, e->window);
+		return;
+	}
+
+	adopt_request(&adopt, e->window);
+	adopt_finish(&adopt);
+}
+
+/*
+ * Manage the windows that were already mapped when the WM started. The
+ * attributes and properties of every top-level window are requested
+ * before the first reply is read. Returns the number of windows adopted.
+ */
+uint32_t
+adopt_existing(const xcb_query_tree_cookie_t cookie)
+{
+	xcb_query_tree_reply_t *tree = STATS_REPLY(xcb_query_tree_reply(connection, cookie, NULL));
+
+	if (!tree)
+	{
+		return 0;
+	}
+
+	const int children_len = xcb_query_tree_children_length(tree);
+	const xcb_window_t *children = xcb_query_tree_children(tree);
+
+	xcb_get_window_attributes_cookie_t *attributes = malloc(children_len * sizeof(xcb_get_window_attributes_cookie_t));
+	wm_adopt_t *adopt = malloc(children_len * sizeof(wm_adopt_t));
+
+	if (!attributes || !adopt)
+	{
+		free(attributes);
+		free(adopt);
+		free(tree);
+		return 0;
+	}
+
+	for (int i = 0; i < children_len; ++i)
+	{
+		attributes[i] = xcb_get_window_attributes(connection, children[i]);
+		adopt_request(&adopt[i], children[i]);
+	}
+
+	uint32_t adopted = 0;
+	xcb_window_t top = 0;
+
+	// Children come bottom to top, so the stack order is kept
+	for (int i = 0; i < children_len; ++i)
+	{
+		xcb_get_window_attributes_reply_t *reply = STATS_REPLY(xcb_get_window_attributes_reply(connection,
+				attributes[i], NULL));
+
+		const bool manage = reply
+			&& !reply->override_redirect
+			&& reply->map_state == XCB_MAP_STATE_VIEWABLE;
+
+		free(reply);
+
+		if (!manage)
+		{
+			xcb_discard_reply(connection, adopt[i].geometry.sequence);
+			adopt_discard(&adopt[i]);
+			continue;
+		}
+
+		adopt[i].mapped = true;
+
+		const int32_t index = adopt_finish(&adopt[i]);
+		if (index != -1)
+		{
+			top = table.windows[index].frame;
+			++adopted;
+		}
+	}
+
+	if (top)
+	{
+		update_current(top, event_time);
+		update_bar();
+	}
+
+	free(attributes);
+	free(adopt);
+	free(tree);
+
+	return adopted;
+}
+
+void
+property_notify(xcb_generic_event_t *event)
+{
+	xcb_property_notify_event_t *e = (xcb_property_notify_event_t *) event;
+
+	//printf("Atom: %d == %d\n", e->atom, XCB_ATOM_WM_NAME);
+
+	if (e->atom == XCB_ATOM_WM_NAME || e->atom == wm_atoms[WM_ATOMS_NET_WM_NAME])
+	{	// Window name changed
+		title_request(e->window);
+	}
+}
+
+void
+frame_kill(const xcb_window_t frame)
+{
+	const int32_t index = find_frame(frame);
+	if (index == -1)
+	{
+		return;
+	}
+
+	// Clients that do not speak WM_DELETE_WINDOW are killed outright. The
+	// window stays managed until its own UnmapNotify or DestroyNotify, a
+	// client may ask to save first or refuse to close
+	if (table.windows[index].protocols & WM_PROTOCOL_DELETE)
+	{
+		send_event(table.windows[index].id, wm_atoms[WM_ATOMS_DELETE], event_time);
+	}
+	else
+	{
+		xcb_kill_client(connection, table.windows[index].id);
+	}
+}
+
+void
+key_press(xcb_generic_event_t *event)
+{
+	xcb_key_press_event_t *e = (xcb_key_press_event_t *) event;
+
+	xcb_keysym_t keysym = xcb_key_symbols_get_keysym(syms, e->detail, 0);
+
+	//printf("keysym got: %d | q: %d\n", keysym, XK_q);
+	switch (keysym)
+	{
+	case XK_e:	// Exit window manager
+		//printf("state: %d\n", e->state);
+		if (e->state == (PRIMARY_MOD_KEY | XCB_MOD_MASK_SHIFT))
+		{
+			printf("Closing wm\n");
+			running = false;
+		}
+		break;
+	case XK_q:	// Kill window
+		if (e->state == (PRIMARY_MOD_KEY | XCB_MOD_MASK_SHIFT))
+		{
+			frame_kill(e->child);
+			update_bar();
+			//xcb_kill_client(connection, window);
+		}
+		break;
+	case XK_a:	// Raise window
+		update_current(e->child, e->time);
+		frame_raise(e->child);
+		update_bar();
+		break;
+	case XK_b:
+		toggle_bar();
+		break;
+	case XK_t:	// Cycle the layout of the monitor under the pointer
+	{
+		wm_monitor_t *monitor = &monitors[monitor_at(e->root_x, e->root_y)];
+
+		monitor->layout = (monitor->layout + 1) % LAYOUT_ALL;
+		monitor->layout_dirty = true;
+	} break;
+	default:
+		if (keysym >= XK_1 && keysym <= XK_9)
+		{
+			const int32_t index = find_frame(e->child);
+
+			if (e->state == (PRIMARY_MOD_KEY | XCB_MOD_MASK_SHIFT))
+			{
+				if (index != -1)
+				{
+					workspace_send(index, keysym - XK_1);
+				}
+			}
+			else
+			{
+				workspace_switch(monitor_at(e->root_x, e->root_y), keysym - XK_1);
+			}
+
+			break;
+		}
+
+		for (uint32_t i = 0; i < sizeof(config_commands) / sizeof(config_commands[0]); ++i)
+		{
+			if (config_commands[i].keysym == keysym)
+			{
+				launch_command(&launch, config_commands[i].command);
+				break;
+			}
+		}
+		break;
+	}
+}
+
+/*
+ * Sides a resize grabbed at root x, y moves: on each axis the one whose
+ * third of the frame holds the pointer, none from the middle third.
+ */
+uint8_t
+drag_edges(const xcb_rectangle_t *rect, const int32_t x, const int32_t y)
+{
+	uint8_t edges = 0;
+
+	if (x < rect->x + rect->width / 3)
+	{
+		edges |= WM_EDGE_LEFT;
+	}
+	else if (x >= rect->x + rect->width * 2 / 3)
+	{
+		edges |= WM_EDGE_RIGHT;
+	}
+
+	if (y < rect->y + rect->height / 3)
+	{
+		edges |= WM_EDGE_TOP;
+	}
+	else if (y >= rect->y + rect->height * 2 / 3)
+	{
+		edges |= WM_EDGE_BOTTOM;
+	}
+
+	return edges;
+}
+
+void
+button_press(xcb_generic_event_t *event)
+{
+	xcb_button_press_event_t *e = (xcb_button_press_event_t *) event;
+
+	// Ignore it (background)
+	if (e->child == 0)
+	{
+		return;
+	}
+
+	// Set border of old one as un-focused
+	const xcb_window_t window = e->child;
+	update_current(window, e->time);
+
+	// Raise window
+	frame_raise(window);
+
+	update_bar();
+
+	// Fullscreen windows are neither moved nor resized
+	const int32_t index = find_frame(window);
+	if (index == -1 || table.windows[index].fullscreen)
+	{
+		return;
+	}
+
+	drag.frame = window;
+	drag.window = table_handle(&table, index);
+	drag.pointer_x = e->root_x;
+	drag.pointer_y = e->root_y;
+	drag.start = table.windows[index].rect;
+	drag.last = drag.start;
+
+	uint32_t cursor = WM_CURSOR_NORMAL;
+
+	switch (e->detail)
+	{
+	case 1: // Move
+		window_track(index, false);
+		drag.mode = WM_DRAG_MOVE;
+		cursor = WM_CURSOR_MOVE;
+		break;
+	case 3: // Resize
+		drag.mode = WM_DRAG_RESIZE;
+		drag.edges = drag_edges(&drag.start, e->root_x, e->root_y);
+		cursor = edge_cursors[drag.edges];
+
+		// From the middle the bottom right corner follows the pointer
+		if (drag.edges == 0)
+		{
+			drag.edges = WM_EDGE_RIGHT | WM_EDGE_BOTTOM;
+		}
+		break;
+	default:
+		drag.mode = WM_DRAG_NONE;
+		return;
+	}
+
+	// The grab carries the cursor, it reverts by itself on ungrab
+	xcb_grab_pointer(connection, 0, root,
+			XCB_EVENT_MASK_BUTTON_RELEASE | XCB_EVENT_MASK_BUTTON_MOTION,
+			XCB_GRAB_MODE_ASYNC, XCB_GRAB_MODE_ASYNC,
+			root, cursors[cursor], XCB_CURRENT_TIME);
+}
+
+void
+enter_window(xcb_generic_event_t *event)
+{
+	xcb_enter_notify_event_t *e = (xcb_enter_notify_event_t *) event;
+
+	update_current(e->event, e->time);
+	update_bar();
+}
+
+uint64_t
+clock_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/*
+ * Point the window's sync alarm at its current sync value, creating the
+ * alarm the first time. The alarm id goes into sync_alarms, its own index
+ * next to the window ids, so AlarmNotify finds the window in constant time.
+ */
+void
+sync_alarm_arm(const int32_t index)
+{
+	wm_window_t *window = &table.windows[index];
+	const uint32_t alarm_values[] = {
+		window->sync_counter,
+		XCB_SYNC_VALUETYPE_ABSOLUTE,
+		window->sync_value >> 32,
+		window->sync_value & 0xFFFFFFFF,
+		XCB_SYNC_TESTTYPE_POSITIVE_COMPARISON,
+		true
+	};
+	const uint32_t mask = XCB_SYNC_CA_COUNTER |
+		XCB_SYNC_CA_VALUE_TYPE |
+		XCB_SYNC_CA_VALUE |
+		XCB_SYNC_CA_TEST_TYPE |
+		XCB_SYNC_CA_EVENTS;
+
+	if (window->sync_alarm)
+	{
+		xcb_sync_change_alarm(connection, window->sync_alarm, mask, alarm_values);
+		return;
+	}
+
+	window->sync_alarm = xcb_generate_id(connection);
+	xcb_sync_create_alarm(connection, window->sync_alarm, mask, alarm_values);
+	hash_insert(&sync_alarms, window->sync_alarm, index);
+}
+
+/*
+ * Ask the client to report, through its sync counter, when it has
+ * finished painting the size about to be sent.
+ */
+void
+sync_request(const int32_t index, const uint64_t now)
+{
+	wm_window_t *window = &table.windows[index];
+
+	++window->sync_value;
+	sync_alarm_arm(index);
+
+	xcb_client_message_event_t event = {
+		.response_type = XCB_CLIENT_MESSAGE,
+		.format = 32,
+		.window = window->id,
+		.type = wm_atoms[WM_ATOMS_PROTOCOLS],
+		.data.data32 = {
+			wm_atoms[WM_ATOMS_SYNC_REQUEST],
+			XCB_CURRENT_TIME,
+			window->sync_value & 0xFFFFFFFF,
+			window->sync_value >> 32
+		}
+	};
+
+	xcb_send_event(connection, false, window->id, XCB_EVENT_MASK_NO_EVENT,
+			(char *) &event);
+
+	window->sync_waiting = true;
+	window->sync_sent = now;
+}
+
+/*
+ * Send the pending interactive resize if the client is ready for it:
+ * synced clients once they painted the previous size (or timed out),
+ * others at most once per CONFIG_RESIZE_INTERVAL_MS. Anything held back
+ * is retried by the main loop, see loop_timeout().
+ */
+void
+drag_resize_flush(const bool force)
+{
+	if (!drag.pending)
+	{
+		return;
+	}
+
+	const int32_t index = table_resolve(&table, drag.window);
+	if (index == -1)
+	{
+		drag.pending = false;
+		return;
+	}
+
+	const wm_window_t *window = &table.windows[index];
+	const uint64_t now = clock_ms();
+
+	if (window->protocols & WM_PROTOCOL_SYNC_REQUEST)
+	{
+		if (!force && window->sync_waiting &&
+				now - window->sync_sent < CONFIG_SYNC_TIMEOUT_MS)
+		{
+			return;
+		}
+
+		sync_request(index, now);
+	}
+	else if (!force && now - drag.resized < CONFIG_RESIZE_INTERVAL_MS)
+	{
+		return;
+	}
+
+	drag.pending = false;
+	drag.resized = now;
+
+	if (drag.last.x != table.windows[index].rect.x || drag.last.y != table.windows[index].rect.y)
+	{
+		frame_configure(index,
+				XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y,
+				(uint32_t []) { drag.last.x, drag.last.y });
+	}
+
+	frame_update_size(drag.frame, drag.last.width, drag.last.height);
+}
+
+void
+sync_alarm_notify(xcb_generic_event_t *event)
+{
+	xcb_sync_alarm_notify_event_t *e = (xcb_sync_alarm_notify_event_t *) event;
+
+	const int32_t index = hash_find(&sync_alarms, e->alarm);
+	if (index == -1 || table.windows[index].sync_alarm != e->alarm)
+	{
+		return;
+	}
+
+	table.windows[index].sync_waiting = false;
+	drag_resize_flush(false);
+}
+
+void
+mouse_motion(xcb_generic_event_t *event)
+{
+	xcb_motion_notify_event_t *e = (xcb_motion_notify_event_t *) event;
+
+	// The window may have gone away mid-drag
+	if (drag.mode == WM_DRAG_NONE || table_resolve(&table, drag.window) == -1)
+	{
+		return;
+	}
+
+	const int32_t dx = e->root_x - drag.pointer_x;
+	const int32_t dy = e->root_y - drag.pointer_y;
+
+	switch (drag.mode)
+	{
+	case WM_DRAG_MOVE:
+	{
+		const wm_window_t *window = &table.windows[table_resolve(&table, drag.window)];
+		xcb_rectangle_t outer = {
+			.x = drag.start.x + dx,
+			.y = drag.start.y + dy,
+			.width = drag.start.width + 2 * window->border,
+			.height = drag.start.height + 2 * window->border
+		};
+
+		snap_find(&snap, drag.frame, &outer, CONFIG_SNAP_DISTANCE);
+
+		int32_t x = outer.x;
+		int32_t y = outer.y;
+
+		// Keep the window on the monitor under the pointer
+		const xcb_rectangle_t *area = &monitors[monitor_at(e->root_x, e->root_y)].rect;
+
+		if (x + drag.start.width > area->x + area->width)
+		{
+			x = area->x + area->width - drag.start.width;
+		}
+
+		if (y + drag.start.height > area->y + area->height)
+		{
+			y = area->y + area->height - drag.start.height;
+		}
+
+		x = (x < area->x) ? area->x : x;
+		y = (y < area->y) ? area->y : y;
+
+		if (x == drag.last.x && y == drag.last.y)
+		{
+			break;
+		}
+
+		const int32_t index = table_resolve(&table, drag.window);
+
+		drag.last.x = x;
+		drag.last.y = y;
+
+		frame_configure(index,
+				XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y,
+				(uint32_t []) { x, y });
+	} break;
+	case WM_DRAG_RESIZE:
+	{
+		int32_t width = drag.start.width;
+		int32_t height = drag.start.height;
+
+		if (drag.edges & WM_EDGE_LEFT) width -= dx;
+		if (drag.edges & WM_EDGE_RIGHT) width += dx;
+		if (drag.edges & WM_EDGE_TOP) height -= dy;
+		if (drag.edges & WM_EDGE_BOTTOM) height += dy;
+
+		// Respect the client's WM_NORMAL_HINTS size limits
+		const wm_window_t *window = &table.windows[table_resolve(&table, drag.window)];
+		const int32_t min_width = (window->min_width > MIN_WIDTH) ? window->min_width : MIN_WIDTH;
+		const int32_t min_height = (window->min_height + CONFIG_FRAME_BAR > MIN_HEIGHT) ?
+			window->min_height + CONFIG_FRAME_BAR : MIN_HEIGHT;
+
+		width = (width < min_width) ? min_width : width;
+		height = (height < min_height) ? min_height : height;
+
+		if (window->max_width && width > window->max_width)
+		{
+			width = window->max_width;
+		}
+
+		if (window->max_height && height > window->max_height + CONFIG_FRAME_BAR)
+		{
+			height = window->max_height + CONFIG_FRAME_BAR;
+		}
+
+		// Dragging the left or top side keeps the opposite one in place
+		const int32_t x = (drag.edges & WM_EDGE_LEFT) ?
+			drag.start.x + drag.start.width - width : drag.start.x;
+		const int32_t y = (drag.edges & WM_EDGE_TOP) ?
+			drag.start.y + drag.start.height - height : drag.start.y;
+
+		if (width == drag.last.width && height == drag.last.height)
+		{
+			break;
+		}
+
+		drag.last = (xcb_rectangle_t) { x, y, width, height };
+		drag.pending = true;
+
+		drag_resize_flush(false);
+	} break;
+	}
+}
+
+void
+configure_notify(xcb_generic_event_t *event)
+{
+	xcb_configure_notify_event_t *e = (xcb_configure_notify_event_t *) event;
+
+	const int32_t index = find_frame(e->window);
+	if (index == -1)
+	{
+		return;
+	}
+
+	const xcb_rectangle_t rect = {
+		.x = e->x,
+		.y = e->y,
+		.width = e->width,
+		.height = e->height
+	};
+
+	// Usually just the echo of frame_configure(), which is already cached
+	if (rect_equal(&table.windows[index].rect, &rect) &&
+			table.windows[index].border == e->border_width)
+	{
+		return;
+	}
+
+	window_track(index, false);
+	table.windows[index].rect = rect;
+	table.windows[index].border = e->border_width;
+	window_track(index, true);
+}
+
+void
+expose(xcb_generic_event_t *event)
+{
+	xcb_expose_event_t *e = (xcb_expose_event_t *) event;
+
+	if (e->count != 0)
+	{
+		return;
+	}
+
+	// The back-buffer is always current, so just copy it back in
+	for (uint32_t i = 0; i < monitors_len; ++i)
+	{
+		if (e->window == monitors[i].bar.window)
+		{
+			bar_present(&monitors[i].bar);
+			return;
+		}
+	}
+}
+
+void
+button_release(xcb_generic_event_t *event)
+{
+	(void) event;
+
+	// The final size always goes out, whatever the pacing
+	drag_resize_flush(true);
+
+	// The moved window rejoins the snap index where it was dropped
+	const bool moved = drag.mode == WM_DRAG_MOVE;
+	const int32_t index = table_resolve(&table, drag.window);
+
+	drag.mode = WM_DRAG_NONE;
+
+	// A tiled window dropped anywhere goes back to a tile, or joins the
+	// tiles of the monitor it was dropped on
+	if (moved && index != -1)
+	{
+		window_track(index, true);
+		monitors[monitor_at(drag.start.x + drag.start.width / 2,
+				drag.start.y + drag.start.height / 2)].layout_dirty = true;
+		layout_mark(index);
+	}
+
+	xcb_ungrab_pointer(connection, XCB_CURRENT_TIME);
+}
+
+void
+setup_visual_type(void)
+{
+	for (xcb_depth_iterator_t depth_iter = xcb_screen_allowed_depths_iterator(screen);
+			depth_iter.rem;
+			xcb_depth_next(&depth_iter))
+	{
+		for (xcb_visualtype_iterator_t visual_iter = xcb_depth_visuals_iterator(depth_iter.data);
+				visual_iter.rem;
+				xcb_visualtype_next(&visual_iter))
+		{
+			if (screen->root_visual == visual_iter.data->visual_id)
+			{
+				visual_type = visual_iter.data;
+				return;
+			}
+		}
+	}
+}
+
+/*
+ * Stop managing a window: give the client back to the root window (unless
+ * it is already gone), destroy its frame and release its table slot.
+ */
+void
+window_unmanage(const int32_t index, const bool destroyed)
+{
+	const wm_window_t *window = &table.windows[index];
+
+	printf("unmanage: %d | frame: %d\n", window->id, window->frame);
+
+	window_track(index, false);
+	layout_mark(index);
+	workspace_unlink(index);
+	ewmh_client_remove(window->id);
+	ipc_event(&ipc, "unmap 0x%x\n", window->id);
+
+	if (!destroyed)
+	{
+		xcb_change_window_attributes(connection,
+				window->id,
+				XCB_CW_EVENT_MASK,
+				(uint32_t [1]) { XCB_EVENT_MASK_NO_EVENT });
+		xcb_reparent_window(connection, window->id, root,
+				window->rect.x, window->rect.y);
+		xcb_delete_property(connection, window->id, wm_atoms[WM_ATOMS_NET_WM_STATE]);
+	}
+
+	xcb_destroy_window(connection, window->frame);
+
+	for (uint32_t focus = 0; focus < 2; ++focus)
+	{
+		if (window->decor[focus])
+		{
+			xcb_free_pixmap(connection, window->decor[focus]);
+		}
+	}
+
+	if (window->sync_alarm)
+	{
+		hash_remove(&sync_alarms, window->sync_alarm);
+		xcb_sync_destroy_alarm(connection, window->sync_alarm);
+	}
+
+	if (current.frame == window->frame)
+	{
+		current_clear();
+	}
+
+	title_discard(&table.windows[index]);
+	table_remove(&table, index);
+	update_bar();
+}
+
+void
+unmap_notify(xcb_generic_event_t *event)
+{
+	xcb_unmap_notify_event_t *e = (xcb_unmap_notify_event_t *) event;
+
+	// Frames are reported here too, only a client withdrawing matters
+	const int32_t index = find_window(e->window);
+	if (index == -1)
+	{
+		return;
+	}
+
+	if (table.windows[index].ignore_unmaps)
+	{
+		--table.windows[index].ignore_unmaps;
+		return;
+	}
+
+	window_unmanage(index, false);
+}
+
+void
+destroy_notify(xcb_generic_event_t *event)
+{
+	xcb_destroy_notify_event_t *e = (xcb_destroy_notify_event_t *) event;
+
+	const int32_t index = find_window(e->window);
+	if (index == -1)
+	{
+		return;
+	}
+
+	window_unmanage(index, true);
+}
+
+/*
+ * EWMH requests from clients and pagers: activating a window, which also
+ * shows its workspace, and adding, removing or toggling fullscreen.
+ */
+void
+client_message(xcb_generic_event_t *event)
+{
+	xcb_client_message_event_t *e = (xcb_client_message_event_t *) event;
+
+	const int32_t index = find_window(e->window);
+	if (index == -1 || e->format != 32)
+	{
+		return;
+	}
+
+	wm_window_t *window = &table.windows[index];
+
+	if (e->type == wm_atoms[WM_ATOMS_NET_ACTIVE_WINDOW])
+	{
+		if (!window->visible)
+		{
+			workspace_switch(window->monitor, window->workspace);
+		}
+
+		// The requester's timestamp, if it sent one
+		update_current(window->frame, (e->data.data32[1]) ? e->data.data32[1] : event_time);
+		frame_raise(window->frame);
+		update_bar();
+	}
+	else if (e->type == wm_atoms[WM_ATOMS_NET_WM_STATE] &&
+			(e->data.data32[1] == wm_atoms[WM_ATOMS_NET_WM_STATE_FULLSCREEN] ||
+			 e->data.data32[2] == wm_atoms[WM_ATOMS_NET_WM_STATE_FULLSCREEN]))
+	{
+		// _NET_WM_STATE_REMOVE, _ADD or _TOGGLE
+		const uint32_t action = e->data.data32[0];
+
+		if (action <= 2)
+		{
+			window_fullscreen(index, (action == 2) ? !window->fullscreen : action == 1);
+		}
+	}
+}
+
+void
+cleanup(void)
+{
+	destroy_bar();
+	destroy_cursors();
+	text_render_destroy();
+	xcb_key_symbols_free(syms);
+	xcb_set_input_focus(connection, XCB_NONE,
+			XCB_INPUT_FOCUS_POINTER_ROOT,
+			XCB_CURRENT_TIME);
+
+	for (uint32_t i = 0; i < table.len; ++i)
+	{
+		if (table.windows[i].id == 0)
+		{
+			continue;
+		}
+
+		xcb_kill_client(connection, table.windows[i].id);
+
+		xcb_unmap_window(connection, table.windows[i].frame);
+		xcb_destroy_window(connection, table.windows[i].frame);
+	}
+
+	table_free(&table);
+	hash_free(&sync_alarms);
+	snap_free(&snap);
+	ipc_free(&ipc);
+	launch_free(&launch);
+	ewmh_list_free(&ewmh_clients);
+	ewmh_list_free(&ewmh_stacking);
+
+	if (ewmh_check)
+	{
+		xcb_destroy_window(connection, ewmh_check);
+
+		for (uint32_t atom = WM_ATOMS_NET_SUPPORTED; atom <= WM_ATOMS_NET_ACTIVE_WINDOW; ++atom)
+		{
+			xcb_delete_property(connection, root, wm_atoms[atom]);
+		}
+	}
+
+	for (uint32_t i = 0; i < STATUS_ALL; ++i)
+	{
+		status_close(&status[i]);
+	}
+
+
+	xcb_flush(connection);
+	xcb_disconnect(connection);
+	printf("Closing martwm\n");
+}
+
+static void	(*events[XCB_NO_OPERATION + 1])(xcb_generic_event_t *) = {
+	[XCB_MAP_REQUEST] = new_window,
+	[XCB_PROPERTY_NOTIFY] = property_notify,
+	[XCB_KEY_PRESS] = key_press,
+	[XCB_BUTTON_PRESS] = button_press,
+	[XCB_ENTER_NOTIFY] = enter_window,
+	[XCB_MOTION_NOTIFY] = mouse_motion,
+	[XCB_BUTTON_RELEASE] = button_release,
+	[XCB_UNMAP_NOTIFY] = unmap_notify,
+	[XCB_CONFIGURE_NOTIFY] = configure_notify,
+	[XCB_DESTROY_NOTIFY] = destroy_notify,
+	[XCB_EXPOSE] = expose,
+
+	//[XCB_CONFIGURE_REQUEST] = ,
+	[XCB_CLIENT_MESSAGE] = client_message,
+};
+
+/*
+ * Register a file descriptor with the main loop; handler runs whenever
+ * poll reports it readable.
+ */
+bool
+loop_watch(const int fd, void (*handler)(int))
+{
+	uint32_t i = 0;
+
+	// Reuse a slot given up by loop_unwatch()
+	while (i < loop_fds_len && loop_fds[i].fd != -1)
+	{
+		++i;
+	}
+
+	if (i == WM_MAX_FDS)
+	{
+		fprintf(stderr, "ERROR: Cannot watch fd %d, loop is full.\n", fd);
+		return false;
+	}
+
+	loop_fds[i] = (struct pollfd) {
+		.fd = fd,
+		.events = POLLIN
+	};
+	loop_handlers[i] = handler;
+
+	if (i == loop_fds_len)
+	{
+		++loop_fds_len;
+	}
+
+	return true;
+}
+
+/*
+ * Stop watching fd. poll() skips negative fds, so the slot just goes
+ * quiet and the other slots keep their place while handlers run.
+ */
+void
+loop_unwatch(const int fd)
+{
+	for (uint32_t i = 0; i < loop_fds_len; ++i)
+	{
+		if (loop_fds[i].fd == fd)
+		{
+			loop_fds[i].fd = -1;
+			loop_fds[i].revents = 0;
+			return;
+		}
+	}
+}
+
+/*
+ * Also run fd's handler when it becomes writable, for as long as wait.
+ */
+void
+loop_wait_writable(const int fd, const bool wait)
+{
+	for (uint32_t i = 0; i < loop_fds_len; ++i)
+	{
+		if (loop_fds[i].fd == fd)
+		{
+			loop_fds[i].events = (wait) ? POLLIN | POLLOUT : POLLIN;
+			return;
+		}
+	}
+}
+
+/*
+ * The font thread is done: draw every title that went out without text.
+ */
+void
+text_render_done(const int fd)
+{
+	char byte;
+
+	if (read(fd, &byte, 1) == -1 && errno == EINTR)
+	{
+		return;
+	}
+
+	loop_unwatch(text_render_pipe[0]);
+	text_render_join();
+	text_render_ready = true;
+
+	printf("Fonts ready in %llu ms\n", (unsigned long long) (clock_ms() - start_ms));
+	fflush(stdout);
+
+	for (uint32_t i = 0; i < table.len; ++i)
+	{
+		if (table.windows[i].id)
+		{
+			frame_decor_invalidate(i);
+		}
+	}
+
+	bar_dirty();
+	update_bar();
+}
+
+/*
+ * Load the fonts on a thread so windows are managed meanwhile, or right
+ * here when background is false or the thread cannot be started.
+ */
+void
+text_render_setup(const bool background)
+{
+	pa_desc = pango_font_description_from_string(CONFIG_FONT);
+
+	if (background && pipe(text_render_pipe) == 0)
+	{
+		// Keep the pipe out of launched programs
+		fcntl(text_render_pipe[0], F_SETFD, FD_CLOEXEC);
+		fcntl(text_render_pipe[1], F_SETFD, FD_CLOEXEC);
+
+		if (pthread_create(&text_render_thread, NULL, text_render_load, NULL) == 0)
+		{
+			loop_watch(text_render_pipe[0], text_render_done);
+			return;
+		}
+
+		close(text_render_pipe[0]);
+		close(text_render_pipe[1]);
+		text_render_pipe[0] = text_render_pipe[1] = -1;
+	}
+
+	text_render_load(NULL);
+	text_render_ready = true;
+
+	printf("Fonts ready in %llu ms\n", (unsigned long long) (clock_ms() - start_ms));
+}
+
+/*
+ * Remember the server time of events that carry one.
+ */
+void
+event_time_update(const xcb_generic_event_t *ev)
+{
+	switch (ev->response_type & ~0x80)
+	{
+	// All laid out like a key press
+	case XCB_KEY_PRESS:
+	case XCB_KEY_RELEASE:
+	case XCB_BUTTON_PRESS:
+	case XCB_BUTTON_RELEASE:
+	case XCB_MOTION_NOTIFY:
+	case XCB_ENTER_NOTIFY:
+	case XCB_LEAVE_NOTIFY:
+		event_time = ((const xcb_key_press_event_t *) ev)->time;
+		break;
+	case XCB_PROPERTY_NOTIFY:
+		event_time = ((const xcb_property_notify_event_t *) ev)->time;
+		break;
+	}
+}
+
+/*
+ * Dispatch ev and everything queued behind it. Runs of motion events are
+ * collapsed to the newest one so a drag costs one configure per batch.
+ * Handlers only queue requests; the main loop flushes once per wakeup.
+ */
+void
+events_drain(xcb_generic_event_t *ev)
+{
+	while (ev)
+	{
+		xcb_generic_event_t *next = xcb_poll_for_queued_event(connection);
+		const uint8_t type = ev->response_type & ~0x80;
+
+		if (type == XCB_MOTION_NOTIFY && next &&
+				(next->response_type & ~0x80) == XCB_MOTION_NOTIFY)
+		{
+			free(ev);
+			ev = next;
+			continue;
+		}
+
+		event_time_update(ev);
+
+		if (events[type] != NULL)
+		{
+			const uint64_t start = stats_event_begin(type);
+			events[type](ev);
+			stats_event_end(start);
+		}
+
+		free(ev);
+		++loop_depth;
+
+		// A handler waiting on a reply may have queued more events
+		ev = (next) ? next : xcb_poll_for_queued_event(connection);
+	}
+}
+
+/*
+ * How long the main loop may sleep before a held-back resize is due, or
+ * -1 to wait for events only.
+ */
+int
+loop_timeout(void)
+{
+	if (!drag.pending)
+	{
+		return -1;
+	}
+
+	const int32_t index = table_resolve(&table, drag.window);
+	if (index == -1)
+	{
+		return 0;
+	}
+
+	const wm_window_t *window = &table.windows[index];
+	const uint64_t due = (window->protocols & WM_PROTOCOL_SYNC_REQUEST) ?
+		window->sync_sent + CONFIG_SYNC_TIMEOUT_MS :
+		drag.resized + CONFIG_RESIZE_INTERVAL_MS;
+	const uint64_t now = clock_ms();
+
+	return (due > now) ? (int) (due - now) : 0;
+}
+
+void
+stats_signal(int sig)
+{
+	(void) sig;
+
+	stats_requested = 1;
+}
+
+void
+x_events(const int fd)
+{
+	(void) fd;
+
+	events_drain(xcb_poll_for_event(connection));
+}
+
+void
+x_events_queued(void)
+{
+	events_drain(xcb_poll_for_queued_event(connection));
+}
+
+/*
+ * Read the active CRTCs of resources into out and return how many there
+ * are. Every CRTC request goes out before the first reply is read.
+ */
+uint32_t
+randr_monitors(const xcb_randr_get_screen_resources_current_reply_t *resources,
+		wm_monitor_t *out)
+{
+	const uint32_t crtcs_len = xcb_randr_get_screen_resources_current_crtcs_length(resources);
+	const xcb_randr_crtc_t *crtcs = xcb_randr_get_screen_resources_current_crtcs(resources);
+	xcb_randr_get_crtc_info_cookie_t crtcs_cookie[crtcs_len];
+	uint32_t len = 0;
+
+	for (uint32_t i = 0; i < crtcs_len; ++i)
+	{
+		crtcs_cookie[i] = xcb_randr_get_crtc_info(connection, crtcs[i],
+				resources->config_timestamp);
+	}
+
+	for (uint32_t i = 0; i < crtcs_len; ++i)
+	{
+		xcb_randr_get_crtc_info_reply_t *reply = STATS_REPLY(xcb_randr_get_crtc_info_reply(connection,
+				crtcs_cookie[i], NULL));
+
+		if (!reply)
+		{
+			continue;
+		}
+
+		// Disabled CRTCs have no mode and no size
+		if (reply->width != 0 && reply->height != 0 && len < WM_MAX_MONITORS)
+		{
+			out[len] = (wm_monitor_t) {
+				.place.dirty = true,
+				.crtc = crtcs[i],
+				.rect = {
+					.x = reply->x,
+					.y = reply->y,
+					.width = reply->width,
+					.height = reply->height
+				}
+			};
+
+			++len;
+		}
+
+		free(reply);
+	}
+
+	return len;
+}
+
+void
+monitors_print(void)
+{
+	for (uint32_t i = 0; i < monitors_len; ++i)
+	{
+		printf("Monitor: %d: (%d,%d) %d x %d\n",
+				i,
+				monitors[i].rect.x,
+				monitors[i].rect.y,
+				monitors[i].rect.width,
+				monitors[i].rect.height);
+	}
+}
+
+/*
+ * Move a window found on from by the same offset onto to, keeping it
+ * inside to where it fits.
+ */
+void
+monitor_move_window(const int32_t index,
+		const xcb_rectangle_t *from,
+		const xcb_rectangle_t *to)
+{
+	const xcb_rectangle_t *rect = &table.windows[index].rect;
+	int32_t x = to->x + (rect->x - from->x);
+	int32_t y = to->y + (rect->y - from->y);
+
+	if (x + rect->width > to->x + to->width)
+	{
+		x = to->x + to->width - rect->width;
+	}
+
+	if (y + rect->height > to->y + to->height)
+	{
+		y = to->y + to->height - rect->height;
+	}
+
+	x = (x < to->x) ? to->x : x;
+	y = (y < to->y) ? to->y : y;
+
+	if (x == rect->x && y == rect->y)
+	{
+		return;
+	}
+
+	frame_configure(index,
+			XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y,
+			(uint32_t []) { x, y });
+}
+
+/*
+ * Re-read the CRTCs after a hotplug and diff them against monitors[].
+ * Monitors are matched by CRTC and keep their index and bar; only the
+ * windows and bars of a monitor that moved, resized or went away are
+ * touched.
+ */
+void
+randr_update(void)
+{
+	xcb_randr_get_screen_resources_current_reply_t *resources = STATS_REPLY(xcb_randr_get_screen_resources_current_reply(connection,
+			xcb_randr_get_screen_resources_current(connection, root),
+			NULL));
+
+	if (!resources)
+	{
+		return;
+	}
+
+	wm_monitor_t found[WM_MAX_MONITORS];
+	const uint32_t found_len = randr_monitors(resources, found);
+
+	free(resources);
+
+	// Every output is off, keep the old layout until one comes back
+	if (found_len == 0)
+	{
+		return;
+	}
+
+	wm_monitor_t next[WM_MAX_MONITORS];
+	uint32_t next_len = 0;
+	int32_t match[WM_MAX_MONITORS];
+	bool kept[WM_MAX_MONITORS] = { false };
+	bool changed[WM_MAX_MONITORS] = { false };
+
+	for (uint32_t i = 0; i < monitors_len; ++i)
+	{
+		match[i] = -1;
+
+		for (uint32_t j = 0; j < found_len; ++j)
+		{
+			if (!kept[j] && found[j].crtc == monitors[i].crtc)
+			{
+				changed[next_len] = !rect_equal(&monitors[i].rect, &found[j].rect);
+				next[next_len] = found[j];
+				next[next_len].bar = monitors[i].bar;
+				next[next_len].place = monitors[i].place;
+				next[next_len].place.dirty |= changed[next_len];
+				next[next_len].layout = monitors[i].layout;
+				next[next_len].layout_dirty = changed[next_len];
+				memcpy(next[next_len].workspaces, monitors[i].workspaces,
+						sizeof(monitors[i].workspaces));
+				next[next_len].workspace = monitors[i].workspace;
+				match[i] = next_len++;
+				kept[j] = true;
+				break;
+			}
+		}
+	}
+
+	for (uint32_t j = 0; j < found_len; ++j)
+	{
+		if (!kept[j])
+		{
+			next[next_len++] = found[j];
+		}
+	}
+
+	xcb_rectangle_t from[WM_MAX_MONITORS];
+
+	for (uint32_t i = 0; i < monitors_len; ++i)
+	{
+		from[i] = monitors[i].rect;
+
+		if (match[i] != -1)
+		{
+			continue;
+		}
+
+		// Gone monitors hand their workspaces to the first one left
+		bar_destroy(&monitors[i].bar);
+		next[0].layout_dirty = true;
+
+		for (uint32_t k = 0; k < CONFIG_WORKSPACES; ++k)
+		{
+			const wm_workspace_t *gone = &monitors[i].workspaces[k];
+			wm_workspace_t *into = &next[0].workspaces[k];
+
+			for (int32_t index = (gone->len) ? gone->head : -1, after; index != -1; index = after)
+			{
+				after = table.windows[index].workspace_next;
+				table.windows[index].workspace_prev = -1;
+				table.windows[index].workspace_next = (into->len) ? into->head : -1;
+
+				if (into->len)
+				{
+					table.windows[into->head].workspace_prev = index;
+				}
+
+				into->head = index;
+				++into->len;
+			}
+		}
+	}
+
+	for (uint32_t i = 0; i < monitors_len; ++i)
+	{
+		snap_remove(&snap, 0, &monitors[i].rect);
+	}
+
+	memcpy(monitors, next, next_len * sizeof(wm_monitor_t));
+	const uint32_t previous_len = monitors_len;
+	monitors_len = next_len;
+	monitors_index();
+	monitors_print();
+
+	// Windows follow their monitor to its new index and, if it moved,
+	// resized or went away, onto its new area; those of a gone monitor
+	// then show or hide with the workspace they joined
+	for (uint32_t index = 0; index < table.len; ++index)
+	{
+		wm_window_t *window = &table.windows[index];
+
+		if (!window->id || window->monitor >= previous_len)
+		{
+			continue;
+		}
+
+		const uint32_t old = window->monitor;
+		const uint32_t to = (match[old] != -1) ? (uint32_t) match[old] : 0;
+
+		window->monitor = to;
+
+		if (match[old] == -1 || changed[to])
+		{
+			monitor_move_window(index, &from[old], &monitors[to].rect);
+		}
+
+		window_show(index, window->workspace == monitors[to].workspace);
+	}
+
+	for (uint32_t i = 0; i < monitors_len; ++i)
+	{
+		if (!monitors[i].bar.window)
+		{
+			bar_create(&monitors[i].bar, &monitors[i].rect);
+		}
+		else if (changed[i])
+		{
+			bar_resize(&monitors[i].bar, &monitors[i].rect);
+		}
+	}
+
+	update_bar();
+}
+
+void
+randr_screen_change(xcb_generic_event_t *event)
+{
+	xcb_randr_screen_change_notify_event_t *e = (xcb_randr_screen_change_notify_event_t *) event;
+
+	// The event reports the size before rotation
+	if (e->rotation & (XCB_RANDR_ROTATION_ROTATE_90 | XCB_RANDR_ROTATION_ROTATE_270))
+	{
+		screen->width_in_pixels = e->height;
+		screen->height_in_pixels = e->width;
+	}
+	else
+	{
+		screen->width_in_pixels = e->width;
+		screen->height_in_pixels = e->height;
+	}
+
+	monitors_dirty = true;
+}
+
+void
+randr_notify(xcb_generic_event_t *event)
+{
+	(void) event;
+
+	// A hotplug arrives as a burst of these, the loop updates once after it
+	monitors_dirty = true;
+}
+
+void
+setup_randr(const wm_startup_t *startup)
+{
+	monitors_len = 0;
+
+	if (startup->randr)
+	{
+		free(STATS_REPLY(xcb_randr_query_version_reply(connection,
+				startup->randr_version,
+				NULL)));
+
+		xcb_randr_get_screen_resources_current_reply_t *resources = STATS_REPLY(xcb_randr_get_screen_resources_current_reply(connection,
+				startup->randr_resources,
+				NULL));
+
+		if (resources)
+		{
+			monitors_len = randr_monitors(resources, monitors);
+			free(resources);
+		}
+
+		xcb_randr_select_input(connection, root,
+				XCB_RANDR_NOTIFY_MASK_SCREEN_CHANGE |
+				XCB_RANDR_NOTIFY_MASK_CRTC_CHANGE);
+
+		events[(startup->randr->first_event + XCB_RANDR_SCREEN_CHANGE_NOTIFY) & 0x7F] = randr_screen_change;
+		events[(startup->randr->first_event + XCB_RANDR_NOTIFY) & 0x7F] = randr_notify;
+	}
+	else
+	{
+		fprintf(stderr, "WARNING: No RandR extension, using the whole screen.\n");
+	}
+
+	if (monitors_len == 0)
+	{
+		monitors[0].crtc = 0;
+		monitors[0].place.dirty = true;
+		monitors[0].rect = (xcb_rectangle_t) {
+			.x = 0,
+			.y = 0,
+			.width = screen->width_in_pixels,
+			.height = screen->height_in_pixels
+		};
+		monitors_len = 1;
+	}
+
+	monitors_index();
+	monitors_print();
+}
+
+void
+ipc_dropped(const int fd)
+{
+	loop_unwatch(fd);
+}
+
+/*
+ * Look up the window named by a command argument, a client or frame id in
+ * any base strtoul() understands.
+ */
+int32_t
+ipc_window(const char *arg)
+{
+	if (!arg)
 	{
-		return;
+		return -1;
 	}
 
-	// Set border of old one as un-focused
-	const xcb_window_t window = e->child;
-	update_current(window);
-
-	// Raise window
-	values[0] = XCB_STACK_MODE_ABOVE;
-	xcb_configure_window(connection,
-			window,
-			XCB_CONFIG_WINDOW_STACK_MODE,
-			values);
+	const xcb_window_t id = strtoul(arg, NULL, 0);
+	const int32_t index = find_window(id);
 
-	update_bar();
+	return (index != -1) ? index : find_frame(id);
+}
 
-	geom = xcb_get_geometry_reply(connection,
-			xcb_get_geometry(connection, window),
-			NULL);
+bool
+ipc_number(const char *arg, int32_t *value)
+{
+	char *end;
 
-	switch (e->detail)
+	if (!arg)
 	{
-	case 1: // Move
-		values[2] = 1;
-		xcb_warp_pointer(connection, XCB_NONE, window, 0, 0, 0, 0, 1, 1);
-		cursor_change(window, XC_fleur);
-		break;
-	case 3: // Resize
-		values[2] = 3;
-		xcb_warp_pointer(connection, XCB_NONE, window, 0, 0, 0, 0, geom->width, geom->height);
-		cursor_change(window, XC_sizing);
-		break;
+		return false;
 	}
 
-	free(geom);
+	*value = strtol(arg, &end, 0);
 
-	xcb_grab_pointer(connection, 0, root,
-			XCB_EVENT_MASK_BUTTON_RELEASE | XCB_EVENT_MASK_BUTTON_MOTION | XCB_EVENT_MASK_POINTER_MOTION_HINT,
-			XCB_GRAB_MODE_ASYNC, XCB_GRAB_MODE_ASYNC,
-			root, XCB_NONE, XCB_CURRENT_TIME);
-
-	xcb_flush(connection);
+	return *end == '\0';
 }
 
+/*
+ * Run one command line from a control socket client.
+ */
 void
-enter_window(xcb_generic_event_t *event)
+ipc_command(wm_ipc_client_t *client, char *line)
 {
-	xcb_enter_notify_event_t *e = (xcb_enter_notify_event_t *) event;
+	static const char *layouts[LAYOUT_ALL] = {
+		[LAYOUT_FLOATING] = "floating",
+		[LAYOUT_MASTER] = "master",
+		[LAYOUT_GRID] = "grid"
+	};
+	char *save;
+	const char *command = strtok_r(line, " \t", &save);
+	const char *args[3] = { NULL, NULL, NULL };
 
-	update_current(e->event);
-	update_bar();
+	// The rest of the line is the command line to start
+	if (command && strcmp(command, "spawn") == 0)
+	{
+		const pid_t pid = launch_command(&launch, save);
 
-	xcb_flush(connection);
-}
+		if (pid == -1)
+		{
+			ipc_reply(&ipc, client, "error cannot spawn\n");
+		}
+		else
+		{
+			ipc_reply(&ipc, client, "pid %d\n", (int) pid);
+			ipc_reply(&ipc, client, "ok\n");
+		}
 
-void
-mouse_motion(xcb_generic_event_t *event)
-{
-	(void) event;
+		return;
+	}
 
-	xcb_query_pointer_reply_t *pointer = xcb_query_pointer_reply(
-			connection,
-			xcb_query_pointer(connection, root),
-			0);
+	for (uint32_t i = 0; i < 3; ++i)
+	{
+		args[i] = strtok_r(NULL, " \t", &save);
+	}
 
-	if (!pointer)
+	if (!command)
 	{
+		ipc_reply(&ipc, client, "error empty command\n");
 		return;
 	}
 
-	const int16_t pointer_x = pointer->root_x;
-	const int16_t pointer_y = pointer->root_y;
-
-	//printf("motion: %d %d\n", pointer_x, pointer_y);
+	const int32_t index = ipc_window(args[0]);
+	int32_t a, b;
 
-	switch (values[2])
+	if (strcmp(command, "focus") == 0 && index != -1)
 	{
-	case 1: // Move
+		update_current(table.windows[index].frame, event_time);
+		frame_raise(table.windows[index].frame);
+		update_bar();
+	}
+	else if (strcmp(command, "move") == 0 && index != -1 &&
+			ipc_number(args[1], &a) && ipc_number(args[2], &b))
+	{
+		frame_configure(index,
+				XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y,
+				(uint32_t []) { a, b });
+	}
+	else if (strcmp(command, "resize") == 0 && index != -1 &&
+			ipc_number(args[1], &a) && ipc_number(args[2], &b) &&
+			a >= MIN_WIDTH && b + CONFIG_FRAME_BAR >= MIN_HEIGHT)
+	{
+		frame_update_size(table.windows[index].frame, a, b + CONFIG_FRAME_BAR);
+	}
+	else if (strcmp(command, "close") == 0 && index != -1)
+	{
+		frame_kill(table.windows[index].frame);
+	}
+	else if (strcmp(command, "bar") == 0)
+	{
+		toggle_bar();
+	}
+	else if (strcmp(command, "layout") == 0 && args[0])
 	{
-		geom = xcb_get_geometry_reply(connection, xcb_get_geometry(connection, current.frame), NULL);
+		const int32_t focused = find_window(current.id);
+		int32_t monitor = (focused != -1) ? (int32_t) table.windows[focused].monitor : 0;
+		uint32_t layout = 0;
 
-		values[0] = (pointer_x + geom->width > screen->width_in_pixels) ? (screen->width_in_pixels - geom->width) : pointer_x;
-		values[1] = (pointer_y + geom->height > screen->height_in_pixels) ? (screen->height_in_pixels - geom->height) : pointer_y;
+		while (layout < LAYOUT_ALL && strcmp(layouts[layout], args[0]) != 0)
+		{
+			++layout;
+		}
 
-		free(geom);
+		if (layout == LAYOUT_ALL ||
+				(args[1] && (!ipc_number(args[1], &monitor) ||
+					monitor < 0 || (uint32_t) monitor >= monitors_len)))
+		{
+			ipc_reply(&ipc, client, "error layout floating|master|grid [monitor]\n");
+			return;
+		}
 
-		//printf("Move value: %d %d\n", values[0], values[1]);
-		xcb_configure_window(connection, current.frame, XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y, values);
-		xcb_flush(connection);
-	} break;
-	case 3: // Resize
+		monitors[monitor].layout = layout;
+		monitors[monitor].layout_dirty = true;
+	}
+	else if (strcmp(command, "workspace") == 0 && ipc_number(args[0], &a) &&
+			a >= 1 && a <= CONFIG_WORKSPACES)
 	{
-		geom = xcb_get_geometry_reply(connection, xcb_get_geometry(connection, current.frame), NULL);
+		const int32_t focused = find_window(current.id);
+		int32_t monitor = (focused != -1) ? (int32_t) table.windows[focused].monitor : 0;
 
-		if ((pointer_x - geom->x) < MIN_WIDTH || (pointer_y - geom->y) < MIN_HEIGHT)
+		if (args[1] && (!ipc_number(args[1], &monitor) ||
+				monitor < 0 || (uint32_t) monitor >= monitors_len))
 		{
-			break;
+			ipc_reply(&ipc, client, "error workspace <1-%d> [monitor]\n", CONFIG_WORKSPACES);
+			return;
+		}
+
+		workspace_switch(monitor, a - 1);
+	}
+	else if (strcmp(command, "send") == 0 && index != -1 && ipc_number(args[1], &a) &&
+			a >= 1 && a <= CONFIG_WORKSPACES)
+	{
+		workspace_send(index, a - 1);
+	}
+	else if (strcmp(command, "list") == 0)
+	{
+		for (uint32_t i = 0; i < table.len; ++i)
+		{
+			const wm_window_t *window = &table.windows[i];
+
+			if (window->id)
+			{
+				ipc_reply(&ipc, client, "window 0x%x %d %d %u %u %s\n",
+						window->id,
+						window->rect.x, window->rect.y,
+						window->rect.width, window->rect.height,
+						window->name);
+			}
 		}
+	}
+	else if (strcmp(command, "children") == 0)
+	{
+		const uint64_t now = clock_ms();
 
-		values[0] = pointer_x - geom->x;
-		values[1] = pointer_y - geom->y;
+		for (uint32_t i = 0; i < launch.len; ++i)
+		{
+			ipc_reply(&ipc, client, "child %d %llu %s\n",
+					(int) launch.children[i].pid,
+					(unsigned long long) (now - launch.children[i].started) / 1000,
+					launch.children[i].name);
+		}
+	}
+	else if (strcmp(command, "subscribe") == 0)
+	{
+		if (!client->subscribed)
+		{
+			client->subscribed = true;
+			++ipc.subscribers;
+		}
+	}
+	else if (strcmp(command, "stats") == 0)
+	{
+		char *dump = NULL;
+		size_t dump_len = 0;
+		FILE *out = open_memstream(&dump, &dump_len);
 
-		free(geom);
+		if (out)
+		{
+			stats_dump(out);
+			fclose(out);
+			ipc_write(&ipc, client, dump, dump_len);
+		}
 
-		frame_update_size(current.frame, values[0], values[1]);
-		//xcb_configure_window(connection, window, XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT, values);
-		xcb_flush(connection);
-	} break;
+		free(dump);
+	}
+	else
+	{
+		ipc_reply(&ipc, client, "error unknown command or window: %s\n", command);
+		return;
 	}
 
-	free(pointer);
+	ipc_reply(&ipc, client, "ok\n");
 }
 
 void
-button_release(xcb_generic_event_t *event)
+ipc_client_ready(const int fd)
 {
-	(void) event;
-
-	xcb_ungrab_pointer(connection, XCB_CURRENT_TIME);
-	xcb_flush(connection);
+	ipc_flush(&ipc, fd);
+	ipc_read(&ipc, fd);
 }
 
 void
-setup_randr(void)
+ipc_listen_ready(const int fd)
 {
-	/*
-	 * Setup randr by querying its version
-	 */
+	(void) fd;
+
+	const int client = ipc_accept(&ipc);
 
-	xcb_randr_query_version_cookie_t version_cookie = xcb_randr_query_version(
-			connection,
-			XCB_RANDR_MAJOR_VERSION,
-			XCB_RANDR_MINOR_VERSION);
+	if (client != -1 && !loop_watch(client, ipc_client_ready))
+	{
+		ipc_drop(&ipc, client);
+	}
+}
 
-	xcb_randr_query_version_reply_t *version_reply = xcb_randr_query_version_reply(
-			connection,
-			version_cookie,
-			NULL);
+/*
+ * Open the control socket, at MARTWM_SOCKET if set, else in
+ * XDG_RUNTIME_DIR or a private directory under /tmp. The path is exported
+ * so that programs started by the WM find it.
+ */
+void
+setup_ipc(void)
+{
+	char path[sizeof(ipc.path)];
+	const char *env = getenv("MARTWM_SOCKET");
+	const char *runtime = getenv("XDG_RUNTIME_DIR");
+	const char *display = getenv("DISPLAY");
 
-	if (version_reply)
+	if (!display)
 	{
-		free(version_reply);
+		display = "";
 	}
 
-	/*
-	 * Get screen resources
-	 */
+	if (env)
+	{
+		snprintf(path, sizeof(path), "%s", env);
+	}
+	else if (runtime && runtime[0] == '/')
+	{
+		snprintf(path, sizeof(path), "%s/martwm-%s.sock", runtime, display);
+	}
+	else
+	{
+		char dir[32];
 
-	xcb_randr_get_screen_resources_cookie_t screen_res_cookie = xcb_randr_get_screen_resources(
-			connection,
-			root);
+		snprintf(dir, sizeof(dir), "/tmp/martwm-%u", (unsigned) getuid());
 
-	xcb_randr_get_screen_resources_reply_t *screen_res_reply = xcb_randr_get_screen_resources_reply(
-			connection,
-			screen_res_cookie,
-			NULL);
+		if (!ipc_private_dir(dir))
+		{
+			return;
+		}
+
+		snprintf(path, sizeof(path), "%s/%s.sock", dir, display);
+	}
 
-	if (!screen_res_reply)
+	if (!ipc_init(&ipc, path, ipc_command, ipc_dropped, loop_wait_writable))
 	{
 		return;
 	}
 
-	/*
-	 * CRTC
-	 */
+	setenv("MARTWM_SOCKET", ipc.path, 1);
+	loop_watch(ipc.fd, ipc_listen_ready);
+}
 
-	const uint32_t crtcs_len = xcb_randr_get_screen_resources_crtcs_length(screen_res_reply);
-	xcb_randr_crtc_t *crtcs = xcb_randr_get_screen_resources_crtcs(screen_res_reply);
+/*
+ * Announce an EWMH compliant WM: a check window naming it and the list of
+ * supported hints on the root window. Client lists left by a previous WM
+ * are emptied, adopted windows are appended to them afterwards.
+ */
+void
+setup_ewmh(void)
+{
+	const xcb_atom_t supported[] = {
+		wm_atoms[WM_ATOMS_NET_SUPPORTED],
+		wm_atoms[WM_ATOMS_NET_SUPPORTING_WM_CHECK],
+		wm_atoms[WM_ATOMS_NET_CLIENT_LIST],
+		wm_atoms[WM_ATOMS_NET_CLIENT_LIST_STACKING],
+		wm_atoms[WM_ATOMS_NET_ACTIVE_WINDOW],
+		wm_atoms[WM_ATOMS_NET_WM_NAME],
+		wm_atoms[WM_ATOMS_NET_WM_STATE],
+		wm_atoms[WM_ATOMS_NET_WM_STATE_FULLSCREEN],
+		wm_atoms[WM_ATOMS_SYNC_REQUEST]
+	};
 
-	/*
-	 * Send request to X server about crtc information
-	 */
-	xcb_randr_get_crtc_info_cookie_t crtcs_cookie[crtcs_len];
+	ewmh_list_init(&ewmh_clients, WM_WINDOWS_INIT);
+	ewmh_list_init(&ewmh_stacking, WM_WINDOWS_INIT);
 
-	for (uint32_t i = 0; i < crtcs_len; ++i)
-	{
-		crtcs_cookie[i] = xcb_randr_get_crtc_info(connection, crtcs[i], 0);
-	}
+	ewmh_check = xcb_generate_id(connection);
+	xcb_create_window(connection,
+			XCB_COPY_FROM_PARENT,
+			ewmh_check,
+			root,
+			-1, -1,
+			1, 1,
+			0,
+			XCB_WINDOW_CLASS_INPUT_ONLY,
+			XCB_COPY_FROM_PARENT,
+			0, NULL);
 
-	/*
-	 * Recieve reply from X server about crtc information
-	 */
-	xcb_randr_get_crtc_info_reply_t *crtcs_reply[crtcs_len];
+	xcb_change_property(connection, XCB_PROP_MODE_REPLACE, ewmh_check,
+			wm_atoms[WM_ATOMS_NET_SUPPORTING_WM_CHECK], XCB_ATOM_WINDOW, 32, 1, &ewmh_check);
+	xcb_change_property(connection, XCB_PROP_MODE_REPLACE, ewmh_check,
+			wm_atoms[WM_ATOMS_NET_WM_NAME], wm_atoms[WM_ATOMS_UTF8_STRING], 8, 6, "martwm");
+	xcb_change_property(connection, XCB_PROP_MODE_REPLACE, root,
+			wm_atoms[WM_ATOMS_NET_SUPPORTING_WM_CHECK], XCB_ATOM_WINDOW, 32, 1, &ewmh_check);
+	xcb_change_property(connection, XCB_PROP_MODE_REPLACE, root,
+			wm_atoms[WM_ATOMS_NET_SUPPORTED], XCB_ATOM_ATOM, 32,
+			sizeof(supported) / sizeof(supported[0]), supported);
+
+	ewmh_list_publish(&ewmh_clients, WM_ATOMS_NET_CLIENT_LIST, 0);
+	ewmh_list_publish(&ewmh_stacking, WM_ATOMS_NET_CLIENT_LIST_STACKING, 0);
+	ewmh_active(XCB_NONE);
+}
 
-	for (uint32_t i = 0; i < crtcs_len; ++i)
-	{
-		crtcs_reply[i] = xcb_randr_get_crtc_info_reply(connection, crtcs_cookie[i], 0);
+/*
+ * Join the module texts into the string the bars show on the right.
+ */
+void
+status_compose(void)
+{
+	size_t len = 0;
+
+	status_text[0] = '\0';
 
-		if (!crtcs_reply[i])
+	for (uint32_t i = 0; i < STATUS_ALL; ++i)
+	{
+		if (status[i].text[0] == '\0' || len >= sizeof(status_text))
 		{
 			continue;
 		}
 
-		if (crtcs_reply[i]->x != 0 || crtcs_reply[i]->y != 0 ||
-				crtcs_reply[i]->width != 0 || crtcs_reply[i]->height != 0)
-		{
-			monitors[monitors_len].rect.x = crtcs_reply[i]->x;
-			monitors[monitors_len].rect.y = crtcs_reply[i]->y;
-			monitors[monitors_len].rect.width = crtcs_reply[i]->width;
-			monitors[monitors_len].rect.height = crtcs_reply[i]->height;
-
-			printf("Monitor: %d: (%d,%d) %d x %d\n",
-					monitors_len,
-					monitors[monitors_len].rect.x,
-					monitors[monitors_len].rect.y,
-					monitors[monitors_len].rect.width,
-					monitors[monitors_len].rect.height);
+		len += snprintf(status_text + len, sizeof(status_text) - len, "%s%s",
+				(len) ? " | " : "", status[i].text);
+	}
+}
 
-			++monitors_len;
+void
+status_ready(const int fd)
+{
+	for (uint32_t i = 0; i < STATUS_ALL; ++i)
+	{
+		if (status[i].timer == fd && status_update(&status[i]))
+		{
+			status_compose();
+			update_bar();
+			return;
 		}
-
-		free(crtcs_reply[i]);
 	}
-
-	free(screen_res_reply);
 }
 
 void
-setup_visual_type(void)
+setup_status(void)
 {
-	for (xcb_depth_iterator_t depth_iter = xcb_screen_allowed_depths_iterator(screen);
-			depth_iter.rem;
-			xcb_depth_next(&depth_iter))
+	for (uint32_t i = 0; i < STATUS_ALL; ++i)
 	{
-		for (xcb_visualtype_iterator_t visual_iter = xcb_depth_visuals_iterator(depth_iter.data);
-				visual_iter.rem;
-				xcb_visualtype_next(&visual_iter))
+		if (status_open(&status[i], i))
 		{
-			if (screen->root_visual == visual_iter.data->visual_id)
-			{
-				visual_type = visual_iter.data;
-				return;
-			}
+			loop_watch(status[i].timer, status_ready);
 		}
 	}
+
+	status_compose();
+	update_bar();
 }
 
 void
-unmap_notify(xcb_generic_event_t *event)
+launch_ready(const int fd)
 {
-	xcb_unmap_notify_event_t *e = (xcb_unmap_notify_event_t *) event;
+	(void) fd;
 
-#if 1
-	xcb_window_t frame = child_find_frame(e->window);
+	launch_reap(&launch);
+}
 
-	if (!frame)
+void
+setup_launch(void)
+{
+	if (launch_init(&launch) && !loop_watch(launch.fd, launch_ready))
 	{
-		return;
+		launch_free(&launch);
 	}
-#else
-	xcb_window_t frame = current.frame;
-	xcb_window_t window = current.id;
-
-	current.id = 0;
-	current.frame = 0;
-#endif
-
-	printf("unmap_notify: %d | frame: %d\n", e->window, frame);
+}
 
-	xcb_unmap_window(connection, frame);
+void
+setup_sync(const wm_startup_t *startup)
+{
+	if (!startup->sync)
+	{
+		fprintf(stderr, "WARNING: No SYNC extension, resizes are only throttled.\n");
+		return;
+	}
 
-	xcb_reparent_window(connection, e->window, root, 0, 0);
+	free(STATS_REPLY(xcb_sync_initialize_reply(connection,
+			startup->sync_init,
+			NULL)));
 
-	xcb_destroy_window(connection, e->window);
+	sync_event_base = startup->sync->first_event;
+	events[(sync_event_base + XCB_SYNC_ALARM_NOTIFY) & 0x7F] = sync_alarm_notify;
 }
 
+/*
+ * Send every request startup needs an answer to. The root event mask goes
+ * out before the tree query, so no window can map unseen in between.
+ */
 void
-cleanup(void)
+startup_request(wm_startup_t *startup)
 {
-	xcb_free_gc(connection, bar_gc);
-	text_render_destroy();
-	xcb_key_symbols_free(syms);
-	xcb_set_input_focus(connection, XCB_NONE,
-			XCB_INPUT_FOCUS_POINTER_ROOT,
-			XCB_CURRENT_TIME);
+	xcb_prefetch_extension_data(connection, &xcb_randr_id);
+	xcb_prefetch_extension_data(connection, &xcb_sync_id);
+
+	startup->atoms[WM_ATOMS_PROTOCOLS] = 	xcb_intern_atom(connection, 0, 12, "WM_PROTOCOLS");
+	startup->atoms[WM_ATOMS_DELETE] = 	xcb_intern_atom(connection, 0, 16, "WM_DELETE_WINDOW");
+	startup->atoms[WM_ATOMS_STATE] = 	xcb_intern_atom(connection, 0, 8,  "WM_STATE");
+	startup->atoms[WM_ATOMS_TAKEFOCUS] = 	xcb_intern_atom(connection, 0, 13, "WM_TAKE_FOCUS");
+	startup->atoms[WM_ATOMS_NET_WM_NAME] = 	xcb_intern_atom(connection, 0, 12, "_NET_WM_NAME");
+	startup->atoms[WM_ATOMS_UTF8_STRING] = 	xcb_intern_atom(connection, 0, 11, "UTF8_STRING");
+	startup->atoms[WM_ATOMS_SYNC_REQUEST] = xcb_intern_atom(connection, 0, 21, "_NET_WM_SYNC_REQUEST");
+	startup->atoms[WM_ATOMS_SYNC_REQUEST_COUNTER] = xcb_intern_atom(connection, 0, 29, "_NET_WM_SYNC_REQUEST_COUNTER");
+	startup->atoms[WM_ATOMS_NET_SUPPORTED] = xcb_intern_atom(connection, 0, 14, "_NET_SUPPORTED");
+	startup->atoms[WM_ATOMS_NET_SUPPORTING_WM_CHECK] = xcb_intern_atom(connection, 0, 24, "_NET_SUPPORTING_WM_CHECK");
+	startup->atoms[WM_ATOMS_NET_CLIENT_LIST] = xcb_intern_atom(connection, 0, 16, "_NET_CLIENT_LIST");
+	startup->atoms[WM_ATOMS_NET_CLIENT_LIST_STACKING] = xcb_intern_atom(connection, 0, 25, "_NET_CLIENT_LIST_STACKING");
+	startup->atoms[WM_ATOMS_NET_ACTIVE_WINDOW] = xcb_intern_atom(connection, 0, 18, "_NET_ACTIVE_WINDOW");
+	startup->atoms[WM_ATOMS_NET_WM_STATE] = xcb_intern_atom(connection, 0, 13, "_NET_WM_STATE");
+	startup->atoms[WM_ATOMS_NET_WM_STATE_FULLSCREEN] = xcb_intern_atom(connection, 0, 24, "_NET_WM_STATE_FULLSCREEN");
+
+	startup->root = xcb_change_window_attributes_checked(connection, root,
+			XCB_CW_EVENT_MASK,
+			(uint32_t [1]) {
+				XCB_EVENT_MASK_SUBSTRUCTURE_REDIRECT
+				| XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY
+				| XCB_EVENT_MASK_PROPERTY_CHANGE
+				| XCB_EVENT_MASK_BUTTON_PRESS
+			});
 
-	for (uint32_t i = 0; i < windows_len; ++i)
+	startup->tree = xcb_query_tree(connection, root);
+
+	/*
+	 * Extension requests wait for the QueryExtension replies, which are
+	 * answered by now with everything above already on its way
+	 */
+	startup->randr = xcb_get_extension_data(connection, &xcb_randr_id);
+	if (startup->randr && !startup->randr->present)
 	{
-		xcb_kill_client(connection, windows[i].id);
+		startup->randr = NULL;
+	}
 
-		xcb_unmap_window(connection, windows[i].frame);
-		xcb_destroy_window(connection, windows[i].frame);
+	if (startup->randr)
+	{
+		startup->randr_version = xcb_randr_query_version(connection,
+				XCB_RANDR_MAJOR_VERSION,
+				XCB_RANDR_MINOR_VERSION);
+		startup->randr_resources = xcb_randr_get_screen_resources_current(connection, root);
 	}
 
-	xcb_unmap_window(connection, bar);
-	xcb_destroy_window(connection, bar);
+	startup->sync = xcb_get_extension_data(connection, &xcb_sync_id);
+	if (startup->sync && !startup->sync->present)
+	{
+		startup->sync = NULL;
+	}
 
-	xcb_flush(connection);
-	xcb_disconnect(connection);
-	printf("Closing martwm\n");
+	if (startup->sync)
+	{
+		startup->sync_init = xcb_sync_initialize(connection,
+				XCB_SYNC_MAJOR_VERSION,
+				XCB_SYNC_MINOR_VERSION);
+	}
 }
 
 int
@@ -956,8 +4043,22 @@ main(int argc, char **argv)
 	(void) argc;
 	(void) argv;
 
+	start_ms = clock_ms();
+
 	printf("Running martwm\n");
 
+	stats.enabled = getenv("MARTWM_STATS") != NULL;
+	sigaction(SIGUSR1, &(struct sigaction) { .sa_handler = stats_signal }, NULL);
+
+	// Blocks SIGCHLD, so before the font thread starts
+	setup_launch();
+
+	// cleanup() may run before setup_status() opened anything
+	for (uint32_t i = 0; i < STATUS_ALL; ++i)
+	{
+		status[i].fd = status[i].timer = -1;
+	}
+
 	atexit(cleanup);
 	connection = xcb_connect(NULL, NULL);
 	if (xcb_connection_has_error(connection))
@@ -968,25 +4069,24 @@ main(int argc, char **argv)
 	screen = xcb_setup_roots_iterator(xcb_get_setup(connection)).data;
 	root = screen->root;
 
-	xcb_intern_atom_cookie_t atom_cookies[WM_ATOMS_ALL];
+	if (!table_init(&table, WM_WINDOWS_INIT) || !snap_init(&snap, WM_WINDOWS_INIT))
+	{
+		return 1;
+	}
 
-	/* 
-	 * Make requests for atoms
-	 */
-	atom_cookies[WM_ATOMS_PROTOCOLS] = 	xcb_intern_atom(connection, 0, 12, "WM_PROTOCOLS");
-	atom_cookies[WM_ATOMS_DELETE] = 	xcb_intern_atom(connection, 0, 16, "WM_DELETE_WINDOW");
-	atom_cookies[WM_ATOMS_STATE] = 		xcb_intern_atom(connection, 0, 8,  "WM_STATE");
-	atom_cookies[WM_ATOMS_TAKEFOCUS] = 	xcb_intern_atom(connection, 0, 13, "WM_TAKE_FOCUS");
+	wm_startup_t startup;
+
+	startup_request(&startup);
 
 	/*
 	 * Receive responses for atoms
 	 */
 	for (uint32_t i = 0; i < WM_ATOMS_ALL; ++i)
 	{
-		xcb_intern_atom_reply_t *atom_reply = xcb_intern_atom_reply(
+		xcb_intern_atom_reply_t *atom_reply = STATS_REPLY(xcb_intern_atom_reply(
 				connection,
-				atom_cookies[i],
-				NULL);
+				startup.atoms[i],
+				NULL));
 
 		if (atom_reply)
 		{
@@ -995,7 +4095,17 @@ main(int argc, char **argv)
 		}
 	}
 
-	setup_randr();
+	xcb_generic_error_t *error = xcb_request_check(connection, startup.root);
+
+	if (error)
+	{
+		fprintf(stderr, "ERROR Cannot set root window attributes\n");
+		free(error);
+		exit(1);
+	}
+
+	setup_randr(&startup);
+	setup_sync(&startup);
 
 	/*
 	 * Keycodes
@@ -1018,61 +4128,89 @@ main(int argc, char **argv)
 			root, XCB_NONE, 3, PRIMARY_MOD_KEY);
 
 	// Change root cursor
-	cursor_change(root, XC_left_ptr);
+	setup_cursors();
+	cursor_set(WM_CURSOR_NORMAL, root);
 
+	setup_visual_type();
 	setup_overview();
+	setup_ewmh();
 	setup_bar();
 
-	uint32_t root_values[1] = {
-		XCB_EVENT_MASK_SUBSTRUCTURE_REDIRECT
-		| XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY
-		| XCB_EVENT_MASK_PROPERTY_CHANGE
-		| XCB_EVENT_MASK_BUTTON_PRESS
-	};
-	setup_visual_type();
+	text_render_setup(getenv("MARTWM_SYNC_FONTS") == NULL);
 
-	xcb_generic_error_t *error = xcb_request_check(connection,
-			xcb_change_window_attributes_checked(connection, root,
-				XCB_CW_EVENT_MASK, root_values));
+	const uint32_t adopted = adopt_existing(startup.tree);
 
-	if (error)
+	printf("Ready in %llu ms, adopted %u windows\n",
+			(unsigned long long) (clock_ms() - start_ms), adopted);
+	fflush(stdout);
+
+	loop_watch(xcb_get_file_descriptor(connection), x_events);
+	setup_ipc();
+	setup_status();
+
+	running = true;
+
+	// Events may already be queued from the replies read during setup
+	x_events_queued();
+
+	while (running)
 	{
-		fprintf(stderr, "ERROR Cannot set root window attributes\n");
-		free(error);
-		exit(1);
-	}
+		xcb_flush(connection);
+		stats_flush();
+		stats_wakeup(loop_depth);
+		loop_depth = 0;
 
-	text_render_setup();
+		const int ready = poll(loop_fds, loop_fds_len, loop_timeout());
 
-	xcb_flush(connection);
+		if (stats_requested)
+		{
+			stats_requested = 0;
+			stats_dump(stderr);
+		}
 
-	xcb_generic_event_t 	*ev = NULL;
-	void			(*events[XCB_NO_OPERATION])(xcb_generic_event_t *) = {
-		[XCB_MAP_REQUEST] = new_window,
-		[XCB_PROPERTY_NOTIFY] = property_notify,
-		[XCB_KEY_PRESS] = key_press,
-		[XCB_BUTTON_PRESS] = button_press,
-		[XCB_ENTER_NOTIFY] = enter_window,
-		[XCB_MOTION_NOTIFY] = mouse_motion,
-		[XCB_BUTTON_RELEASE] = button_release,
-		[XCB_UNMAP_NOTIFY] = unmap_notify
-
-		//[XCB_DESTROY_NOTIFY] = ,
-		//[XCB_CONFIGURE_REQUEST] = ,
-		//[XCB_CONFIGURE_NOTIFY] = ,
-		//[XCB_CLIENT_MESSAGE] = ,
-	};
+		if (ready == -1)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
 
-	running = true;
+			perror("poll");
+			break;
+		}
 
-	while (running && (ev = xcb_wait_for_event(connection)))
-	{
-		if (events[ev->response_type & ~0x80] != NULL)
+		for (uint32_t i = 0; i < loop_fds_len; ++i)
+		{
+			if (loop_fds[i].revents)
+			{
+				loop_handlers[i](loop_fds[i].fd);
+			}
+		}
+
+		if (monitors_dirty)
 		{
-			events[ev->response_type & ~0x80](ev);
+			monitors_dirty = false;
+			randr_update();
 		}
 
-		free(ev);
+		// Requests made by other fd handlers may have queued X events,
+		// and so may waiting on the title replies
+		x_events_queued();
+
+		while (titles_pending > 0)
+		{
+			title_collect();
+			x_events_queued();
+		}
+
+		drag_resize_flush(false);
+		layout_flush();
+
+		if (xcb_connection_has_error(connection))
+		{
+			fprintf(stderr, "ERROR: Lost connection to the X server\n");
+			break;
+		}
 	}
 
 	exit(0);
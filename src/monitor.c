@@ -0,0 +1,143 @@
+#include <string.h>
+
+#include "monitor.h"
+
+static uint32_t
+monitor_edges_sort(int32_t *edges, uint32_t len)
+{
+	// At most 32 edges, insertion sort then drop duplicates
+	for (uint32_t i = 1; i < len; ++i)
+	{
+		const int32_t edge = edges[i];
+		uint32_t j = i;
+
+		while (j > 0 && edges[j - 1] > edge)
+		{
+			edges[j] = edges[j - 1];
+			--j;
+		}
+
+		edges[j] = edge;
+	}
+
+	uint32_t unique = 0;
+
+	for (uint32_t i = 0; i < len; ++i)
+	{
+		if (unique == 0 || edges[unique - 1] != edges[i])
+		{
+			edges[unique++] = edges[i];
+		}
+	}
+
+	return unique;
+}
+
+/*
+ * Index of the cell column holding v: the last edge not above v, kept
+ * inside the grid so points beyond it land in the border cells.
+ */
+static uint32_t
+monitor_edges_find(const int32_t *edges, const uint32_t len, const int32_t v)
+{
+	uint32_t low = 0;
+	uint32_t high = len - 1;
+
+	while (low + 1 < high)
+	{
+		const uint32_t middle = (low + high) / 2;
+
+		if (edges[middle] <= v)
+		{
+			low = middle;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+
+	return low;
+}
+
+static int64_t
+monitor_distance(const xcb_rectangle_t *rect, const int32_t x, const int32_t y)
+{
+	const int32_t dx = (x < rect->x) ? rect->x - x :
+		(x >= rect->x + rect->width) ? x - (rect->x + rect->width - 1) : 0;
+	const int32_t dy = (y < rect->y) ? rect->y - y :
+		(y >= rect->y + rect->height) ? y - (rect->y + rect->height - 1) : 0;
+
+	return (int64_t) dx * dx + (int64_t) dy * dy;
+}
+
+void
+monitor_grid_build(wm_monitor_grid_t *grid, const xcb_rectangle_t *rects, uint32_t len)
+{
+	memset(grid, 0, sizeof(wm_monitor_grid_t));
+
+	len = (len > MONITOR_MAX) ? MONITOR_MAX : len;
+
+	if (len == 0)
+	{
+		return;
+	}
+
+	for (uint32_t i = 0; i < len; ++i)
+	{
+		grid->rects[i] = rects[i];
+		grid->xs[grid->xs_len++] = rects[i].x;
+		grid->xs[grid->xs_len++] = rects[i].x + rects[i].width;
+		grid->ys[grid->ys_len++] = rects[i].y;
+		grid->ys[grid->ys_len++] = rects[i].y + rects[i].height;
+	}
+
+	grid->len = len;
+	grid->xs_len = monitor_edges_sort(grid->xs, grid->xs_len);
+	grid->ys_len = monitor_edges_sort(grid->ys, grid->ys_len);
+
+	// Judge each cell by its centre, the first monitor wins overlaps
+	for (uint32_t column = 0; column + 1 < grid->xs_len; ++column)
+	{
+		for (uint32_t row = 0; row + 1 < grid->ys_len; ++row)
+		{
+			const int32_t x = grid->xs[column] + (grid->xs[column + 1] - grid->xs[column]) / 2;
+			const int32_t y = grid->ys[row] + (grid->ys[row + 1] - grid->ys[row]) / 2;
+			int64_t best = -1;
+
+			for (uint32_t i = 0; i < len && best != 0; ++i)
+			{
+				const int64_t distance = monitor_distance(&rects[i], x, y);
+
+				if (best == -1 || distance < best)
+				{
+					best = distance;
+					grid->cells[column][row] = i;
+				}
+			}
+		}
+	}
+}
+
+uint32_t
+monitor_grid_find(wm_monitor_grid_t *grid, const int32_t x, const int32_t y)
+{
+	if (grid->len == 0)
+	{
+		return 0;
+	}
+
+	const xcb_rectangle_t *last = &grid->rects[grid->last];
+
+	if (x >= last->x && x < last->x + last->width &&
+			y >= last->y && y < last->y + last->height)
+	{
+		return grid->last;
+	}
+
+	grid->last = grid->cells
+		[monitor_edges_find(grid->xs, grid->xs_len, x)]
+		[monitor_edges_find(grid->ys, grid->ys_len, y)];
+
+	return grid->last;
+}
@@ -0,0 +1,31 @@
+#ifndef MARTWM_MONITOR_H
+#define MARTWM_MONITOR_H
+
+#include <stdint.h>
+
+#include <xcb/xcb.h>
+
+#define MONITOR_MAX 16
+
+/*
+ * Point to monitor lookup. The distinct vertical and horizontal edges of
+ * the monitors cut the screen into a grid of cells, and each cell records
+ * the monitor covering it. Cells no monitor covers hold the closest one,
+ * so every point gets an answer. A query checks the last hit first, since
+ * the pointer rarely changes monitor, then binary searches the edges.
+ */
+typedef struct {
+	int32_t		xs[2 * MONITOR_MAX];
+	int32_t		ys[2 * MONITOR_MAX];
+	uint32_t	xs_len;
+	uint32_t	ys_len;
+	uint8_t		cells[2 * MONITOR_MAX][2 * MONITOR_MAX];
+	xcb_rectangle_t	rects[MONITOR_MAX];
+	uint32_t	len;
+	uint32_t	last;
+} wm_monitor_grid_t;
+
+void monitor_grid_build(wm_monitor_grid_t *grid, const xcb_rectangle_t *rects, uint32_t len);
+uint32_t monitor_grid_find(wm_monitor_grid_t *grid, const int32_t x, const int32_t y);
+
+#endif
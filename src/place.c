@@ -0,0 +1,220 @@
+#include <string.h>
+
+#include "place.h"
+
+static bool
+place_intersects(const xcb_rectangle_t *a, const xcb_rectangle_t *b)
+{
+	return a->x < b->x + b->width && b->x < a->x + a->width &&
+		a->y < b->y + b->height && b->y < a->y + a->height;
+}
+
+static bool
+place_contains(const xcb_rectangle_t *outer, const xcb_rectangle_t *inner)
+{
+	return inner->x >= outer->x && inner->y >= outer->y &&
+		inner->x + inner->width <= outer->x + outer->width &&
+		inner->y + inner->height <= outer->y + outer->height;
+}
+
+static void
+place_push(wm_place_t *place, const int32_t x, const int32_t y,
+		const int32_t width, const int32_t height)
+{
+	// Out of room the piece is lost, placement falls back to cascading
+	if (width <= 0 || height <= 0 || place->len == PLACE_MAX_FREE)
+	{
+		return;
+	}
+
+	place->free[place->len++] = (xcb_rectangle_t) { x, y, width, height };
+}
+
+/*
+ * Drop rectangles lying inside another one, only the maximal ones matter.
+ */
+static void
+place_prune(wm_place_t *place)
+{
+	for (uint32_t i = 0; i < place->len; ++i)
+	{
+		for (uint32_t j = 0; j < place->len; ++j)
+		{
+			if (i != j && place_contains(&place->free[j], &place->free[i]))
+			{
+				place->free[i--] = place->free[--place->len];
+				break;
+			}
+		}
+	}
+}
+
+void
+place_init(wm_place_t *place, const xcb_rectangle_t *area)
+{
+	memset(place, 0, sizeof(wm_place_t));
+
+	place->area = *area;
+	place->free[0] = *area;
+	place->len = 1;
+}
+
+/*
+ * Split the free rectangles rect overlaps around it. Pieces that miss
+ * within are dropped, unless within is NULL.
+ */
+static void
+place_cut(wm_place_t *place, const xcb_rectangle_t *rect, const xcb_rectangle_t *within)
+{
+	const uint32_t len = place->len;
+	uint32_t kept = 0;
+	xcb_rectangle_t split[PLACE_MAX_FREE];
+	uint32_t split_len = 0;
+
+	// Untouched rectangles stay, the touched ones are split below
+	for (uint32_t i = 0; i < len; ++i)
+	{
+		if (place_intersects(&place->free[i], rect))
+		{
+			split[split_len++] = place->free[i];
+		}
+		else
+		{
+			place->free[kept++] = place->free[i];
+		}
+	}
+
+	if (split_len == 0)
+	{
+		return;
+	}
+
+	place->len = kept;
+
+	const int32_t left = rect->x;
+	const int32_t top = rect->y;
+	const int32_t right = rect->x + rect->width;
+	const int32_t bottom = rect->y + rect->height;
+
+	for (uint32_t i = 0; i < split_len; ++i)
+	{
+		const xcb_rectangle_t *f = &split[i];
+		const int32_t f_right = f->x + f->width;
+		const int32_t f_bottom = f->y + f->height;
+
+		const uint32_t first = place->len;
+
+		place_push(place, f->x, f->y, left - f->x, f->height);
+		place_push(place, right, f->y, f_right - right, f->height);
+		place_push(place, f->x, f->y, f->width, top - f->y);
+		place_push(place, f->x, bottom, f->width, f_bottom - bottom);
+
+		for (uint32_t j = first; within && j < place->len; ++j)
+		{
+			if (!place_intersects(&place->free[j], within))
+			{
+				place->free[j--] = place->free[--place->len];
+			}
+		}
+	}
+
+	place_prune(place);
+}
+
+void
+place_occupy(wm_place_t *place, const xcb_rectangle_t *rect)
+{
+	place_cut(place, rect, NULL);
+}
+
+/*
+ * Give back the space of a window that moved away or went. The only new
+ * maximal rectangles are those reaching into rect, so they are cut out of
+ * the whole area by the remaining windows, keeping only pieces that still
+ * reach into it; the rectangles they swallow are then pruned. This costs
+ * one pass over the windows with a handful of pieces, not a rebuild.
+ */
+void
+place_release(wm_place_t *place, const xcb_rectangle_t *rect,
+		const xcb_rectangle_t *windows, const uint32_t len)
+{
+	wm_place_t hole;
+
+	if (!place_intersects(&place->area, rect))
+	{
+		return;
+	}
+
+	place_init(&hole, &place->area);
+
+	for (uint32_t i = 0; i < len && hole.len > 0; ++i)
+	{
+		place_cut(&hole, &windows[i], rect);
+	}
+
+	for (uint32_t i = 0; i < hole.len; ++i)
+	{
+		const xcb_rectangle_t *f = &hole.free[i];
+
+		place_push(place, f->x, f->y, f->width, f->height);
+	}
+
+	place_prune(place);
+}
+
+/*
+ * Top-left corner of the largest free rectangle that fits the size.
+ */
+bool
+place_find(const wm_place_t *place, const uint16_t width, const uint16_t height,
+		int16_t *x, int16_t *y)
+{
+	const xcb_rectangle_t *best = NULL;
+
+	for (uint32_t i = 0; i < place->len; ++i)
+	{
+		const xcb_rectangle_t *f = &place->free[i];
+
+		if (f->width < width || f->height < height)
+		{
+			continue;
+		}
+
+		if (!best || (uint32_t) f->width * f->height > (uint32_t) best->width * best->height)
+		{
+			best = f;
+		}
+	}
+
+	if (!best)
+	{
+		return false;
+	}
+
+	*x = best->x;
+	*y = best->y;
+
+	return true;
+}
+
+/*
+ * Next step down and to the right from the area's corner, starting over
+ * when the window would no longer fit.
+ */
+void
+place_cascade(wm_place_t *place, const uint16_t width, const uint16_t height,
+		int16_t *x, int16_t *y)
+{
+	int32_t offset = place->cascade * PLACE_CASCADE_STEP;
+
+	if (offset + width > place->area.width || offset + height > place->area.height)
+	{
+		place->cascade = 0;
+		offset = 0;
+	}
+
+	++place->cascade;
+
+	*x = place->area.x + offset;
+	*y = place->area.y + offset;
+}
@@ -0,0 +1,38 @@
+#ifndef MARTWM_PLACE_H
+#define MARTWM_PLACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <xcb/xcb.h>
+
+#define PLACE_MAX_FREE 128
+#define PLACE_CASCADE_STEP 32
+
+/*
+ * Free space of one monitor as a list of maximal free rectangles
+ * (MaxRects): every rectangle is as large as it can be without covering a
+ * window, and rectangles may overlap. Occupying space only splits the
+ * rectangles it touches. Freeing space adds the maximal rectangles that
+ * reach into it, found from the windows still there. When most windows
+ * change at once, the owner marks the list dirty and rebuilds it before
+ * the next placement instead.
+ */
+typedef struct {
+	xcb_rectangle_t	area;
+	xcb_rectangle_t	free[PLACE_MAX_FREE];
+	uint32_t	len;
+	uint32_t	cascade;
+	bool		dirty;
+} wm_place_t;
+
+void place_init(wm_place_t *place, const xcb_rectangle_t *area);
+void place_occupy(wm_place_t *place, const xcb_rectangle_t *rect);
+void place_release(wm_place_t *place, const xcb_rectangle_t *rect,
+		const xcb_rectangle_t *windows, const uint32_t len);
+bool place_find(const wm_place_t *place, const uint16_t width, const uint16_t height,
+		int16_t *x, int16_t *y);
+void place_cascade(wm_place_t *place, const uint16_t width, const uint16_t height,
+		int16_t *x, int16_t *y);
+
+#endif
@@ -0,0 +1,339 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "snap.h"
+
+#define SNAP_MIN_CAP 64
+#define SNAP_RUN_STEPS 8
+
+static bool
+edges_init(wm_edge_list_t *list, uint32_t cap)
+{
+	cap = (cap < SNAP_MIN_CAP) ? SNAP_MIN_CAP : cap;
+
+	list->edges = malloc(cap * sizeof(wm_edge_t));
+	list->len = 0;
+	list->cap = (list->edges) ? cap : 0;
+
+	return list->edges != NULL;
+}
+
+/*
+ * Index of the first edge at or after pos, or at pos from from on.
+ */
+static uint32_t
+edges_lower(const wm_edge_list_t *list, const int32_t pos, const int32_t from)
+{
+	uint32_t low = 0;
+	uint32_t high = list->len;
+
+	while (low < high)
+	{
+		const uint32_t middle = (low + high) / 2;
+		const wm_edge_t *edge = &list->edges[middle];
+
+		if (edge->pos < pos || (edge->pos == pos && edge->from < from))
+		{
+			low = middle + 1;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+
+	return low;
+}
+
+/*
+ * Recompute reach along the edges at the position of edge i, from i on.
+ */
+static void
+edges_reach(wm_edge_list_t *list, uint32_t i)
+{
+	int32_t reach = (i > 0 && list->edges[i - 1].pos == list->edges[i].pos) ?
+		list->edges[i - 1].reach : INT32_MIN;
+
+	for (const int32_t pos = list->edges[i].pos; i < list->len && list->edges[i].pos == pos; ++i)
+	{
+		reach = (list->edges[i].to > reach) ? list->edges[i].to : reach;
+		list->edges[i].reach = reach;
+	}
+}
+
+static bool
+edges_insert(wm_edge_list_t *list, const wm_edge_t edge)
+{
+	if (list->len == list->cap)
+	{
+		wm_edge_t *grown = realloc(list->edges, list->cap * 2 * sizeof(wm_edge_t));
+
+		if (!grown)
+		{
+			return false;
+		}
+
+		list->edges = grown;
+		list->cap *= 2;
+	}
+
+	const uint32_t i = edges_lower(list, edge.pos, edge.from);
+
+	memmove(&list->edges[i + 1], &list->edges[i], (list->len - i) * sizeof(wm_edge_t));
+	list->edges[i] = edge;
+	++list->len;
+
+	edges_reach(list, i);
+
+	return true;
+}
+
+static void
+edges_remove(wm_edge_list_t *list, const wm_edge_t edge)
+{
+	for (uint32_t i = edges_lower(list, edge.pos, edge.from);
+			i < list->len && list->edges[i].pos == edge.pos &&
+			list->edges[i].from == edge.from;
+			++i)
+	{
+		const wm_edge_t *found = &list->edges[i];
+
+		if (found->owner == edge.owner && found->to == edge.to)
+		{
+			memmove(&list->edges[i], &list->edges[i + 1], (list->len - i - 1) * sizeof(wm_edge_t));
+			--list->len;
+
+			if (i < list->len && list->edges[i].pos == edge.pos)
+			{
+				edges_reach(list, i);
+			}
+
+			return;
+		}
+	}
+}
+
+/*
+ * Bounds of the run of edges sharing the position of edge i. Short runs
+ * are stepped over, long ones, such as a column of aligned windows, are
+ * crossed by binary search.
+ */
+static uint32_t
+edges_run_end(const wm_edge_list_t *list, uint32_t i)
+{
+	const int32_t pos = list->edges[i].pos;
+
+	for (uint32_t step = 0; step < SNAP_RUN_STEPS; ++step)
+	{
+		if (++i == list->len || list->edges[i].pos != pos)
+		{
+			return i;
+		}
+	}
+
+	return edges_lower(list, pos + 1, INT32_MIN);
+}
+
+static uint32_t
+edges_run_start(const wm_edge_list_t *list, uint32_t i)
+{
+	const int32_t pos = list->edges[i].pos;
+
+	for (uint32_t step = 0; step < SNAP_RUN_STEPS; ++step)
+	{
+		if (i == 0 || list->edges[i - 1].pos != pos)
+		{
+			return i;
+		}
+
+		--i;
+	}
+
+	return edges_lower(list, pos, INT32_MIN);
+}
+
+/*
+ * Whether an edge of another owner in the run [first, end) overlaps
+ * [from, to). The run is walked back from the last edge starting before
+ * to, until reach shows that nothing earlier gets past from.
+ */
+static bool
+edges_hit(const wm_edge_list_t *list,
+		const uint32_t owner,
+		const uint32_t first,
+		const uint32_t end,
+		const int32_t from,
+		const int32_t to)
+{
+	const uint32_t last = (end - first > SNAP_RUN_STEPS) ?
+		edges_lower(list, list->edges[first].pos, to) : end;
+
+	for (uint32_t i = last; i > first && list->edges[i - 1].reach > from; --i)
+	{
+		const wm_edge_t *edge = &list->edges[i - 1];
+
+		if (edge->owner != owner && edge->from < to && edge->to > from)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/*
+ * Shift from pos to the closest edge of another owner that overlaps
+ * [from, to), looking no further than limit. The runs of edges sharing a
+ * position are visited outwards from pos and checked by edges_hit(), so
+ * the scan stops at the first one that qualifies. Returns limit + 1 if
+ * there is none.
+ */
+static int32_t
+edges_nearest_side(const wm_edge_list_t *list,
+		const uint32_t owner,
+		const int32_t pos,
+		const int32_t from,
+		const int32_t to,
+		int32_t limit)
+{
+	const uint32_t split = edges_lower(list, pos, INT32_MIN);
+	int32_t best = limit + 1;
+
+	for (uint32_t first = split, end; first < list->len &&
+			list->edges[first].pos - pos <= limit; first = end)
+	{
+		end = edges_run_end(list, first);
+
+		if (edges_hit(list, owner, first, end, from, to))
+		{
+			best = list->edges[first].pos - pos;
+			limit = best;
+			break;
+		}
+	}
+
+	// Ties go to the edge below, as a scan in position order would
+	for (uint32_t end = split, first; end > 0 &&
+			pos - list->edges[end - 1].pos <= limit; end = first)
+	{
+		first = edges_run_start(list, end - 1);
+
+		if (edges_hit(list, owner, first, end, from, to))
+		{
+			return list->edges[first].pos - pos;
+		}
+	}
+
+	return best;
+}
+
+/*
+ * Smallest shift moving one of the positions a or b onto an edge of
+ * another owner that overlaps [from, to). Returns false if no edge lies
+ * within distance.
+ */
+static bool
+edges_nearest(const wm_edge_list_t *list,
+		const uint32_t owner,
+		const int32_t a,
+		const int32_t b,
+		const int32_t from,
+		const int32_t to,
+		const int32_t distance,
+		int32_t *shift)
+{
+	const int32_t sides[2] = { a, b };
+	int32_t best = distance + 1;
+
+	for (uint32_t side = 0; side < 2; ++side)
+	{
+		// The second side only matters if it gets strictly closer
+		const int32_t limit = (abs(best) <= distance) ? abs(best) - 1 : distance;
+		const int32_t delta = edges_nearest_side(list, owner, sides[side], from, to, limit);
+
+		if (abs(delta) <= limit)
+		{
+			best = delta;
+		}
+	}
+
+	if (abs(best) > distance)
+	{
+		return false;
+	}
+
+	*shift = best;
+
+	return true;
+}
+
+bool
+snap_init(wm_snap_t *snap, const uint32_t cap)
+{
+	if (!edges_init(&snap->vertical, cap * 2) || !edges_init(&snap->horizontal, cap * 2))
+	{
+		snap_free(snap);
+		return false;
+	}
+
+	return true;
+}
+
+void
+snap_free(wm_snap_t *snap)
+{
+	free(snap->vertical.edges);
+	free(snap->horizontal.edges);
+	memset(snap, 0, sizeof(wm_snap_t));
+}
+
+bool
+snap_add(wm_snap_t *snap, const uint32_t owner, const xcb_rectangle_t *rect)
+{
+	const int32_t right = rect->x + rect->width;
+	const int32_t bottom = rect->y + rect->height;
+
+	return edges_insert(&snap->vertical, (wm_edge_t) { rect->x, rect->y, bottom, owner, 0 })
+		&& edges_insert(&snap->vertical, (wm_edge_t) { right, rect->y, bottom, owner, 0 })
+		&& edges_insert(&snap->horizontal, (wm_edge_t) { rect->y, rect->x, right, owner, 0 })
+		&& edges_insert(&snap->horizontal, (wm_edge_t) { bottom, rect->x, right, owner, 0 });
+}
+
+void
+snap_remove(wm_snap_t *snap, const uint32_t owner, const xcb_rectangle_t *rect)
+{
+	const int32_t right = rect->x + rect->width;
+	const int32_t bottom = rect->y + rect->height;
+
+	edges_remove(&snap->vertical, (wm_edge_t) { rect->x, rect->y, bottom, owner, 0 });
+	edges_remove(&snap->vertical, (wm_edge_t) { right, rect->y, bottom, owner, 0 });
+	edges_remove(&snap->horizontal, (wm_edge_t) { rect->y, rect->x, right, owner, 0 });
+	edges_remove(&snap->horizontal, (wm_edge_t) { bottom, rect->x, right, owner, 0 });
+}
+
+/*
+ * Shift rect so that its closest side within distance of an edge lines up
+ * with it, independently on each axis. Returns whether rect moved.
+ */
+bool
+snap_find(const wm_snap_t *snap, const uint32_t owner,
+		xcb_rectangle_t *rect, const int32_t distance)
+{
+	int32_t dx = 0;
+	int32_t dy = 0;
+
+	edges_nearest(&snap->vertical, owner,
+			rect->x, rect->x + rect->width,
+			rect->y, rect->y + rect->height,
+			distance, &dx);
+
+	edges_nearest(&snap->horizontal, owner,
+			rect->y, rect->y + rect->height,
+			rect->x, rect->x + rect->width,
+			distance, &dy);
+
+	rect->x += dx;
+	rect->y += dy;
+
+	return dx != 0 || dy != 0;
+}
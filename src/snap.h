@@ -0,0 +1,55 @@
+#ifndef MARTWM_SNAP_H
+#define MARTWM_SNAP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <xcb/xcb.h>
+
+/*
+ * One side of a rectangle: its position across the axis and the extent
+ * it covers along it, [from, to). reach is kept by the index, the largest
+ * to among the edges at the same position up to this one.
+ */
+typedef struct {
+	int32_t		pos;
+	int32_t		from;
+	int32_t		to;
+	uint32_t	owner;
+	int32_t		reach;
+} wm_edge_t;
+
+typedef struct {
+	wm_edge_t	*edges;
+	uint32_t	len;
+	uint32_t	cap;
+} wm_edge_list_t;
+
+/*
+ * Index of window and monitor edges for snapping. Vertical and horizontal
+ * edges are kept in arrays sorted by position, then by where their extent
+ * starts, so the edges on one line lie in order along it. A query jumps
+ * from one occupied position to the next by binary search, outwards from
+ * the moving window's side and no further than the snap distance. At each
+ * position a binary search on the extent and the reach of the edges
+ * before it tell whether one overlaps the window. Windows lined up in a
+ * column cost a few steps per position, not a walk along the column; only
+ * edges on one line that overlap each other but not the window are still
+ * walked one by one. Adding or removing an edge shifts the array behind
+ * it, which is cheap at desktop window counts but linear in the number of
+ * edges. Edges are tagged with an owner (a frame id, 0 for monitors) so a
+ * window never snaps to itself.
+ */
+typedef struct {
+	wm_edge_list_t	vertical;
+	wm_edge_list_t	horizontal;
+} wm_snap_t;
+
+bool snap_init(wm_snap_t *snap, const uint32_t cap);
+void snap_free(wm_snap_t *snap);
+bool snap_add(wm_snap_t *snap, const uint32_t owner, const xcb_rectangle_t *rect);
+void snap_remove(wm_snap_t *snap, const uint32_t owner, const xcb_rectangle_t *rect);
+bool snap_find(const wm_snap_t *snap, const uint32_t owner,
+		xcb_rectangle_t *rect, const int32_t distance);
+
+#endif
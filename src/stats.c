@@ -0,0 +1,145 @@
+#define _POSIX_C_SOURCE 199309L
+
+#include <time.h>
+
+#include "stats.h"
+
+wm_stats_t stats = { 0 };
+
+static const char *event_names[] = {
+	[0] = "startup",
+	[2] = "KeyPress",
+	[3] = "KeyRelease",
+	[4] = "ButtonPress",
+	[5] = "ButtonRelease",
+	[6] = "MotionNotify",
+	[7] = "EnterNotify",
+	[8] = "LeaveNotify",
+	[9] = "FocusIn",
+	[10] = "FocusOut",
+	[12] = "Expose",
+	[16] = "CreateNotify",
+	[17] = "DestroyNotify",
+	[18] = "UnmapNotify",
+	[19] = "MapNotify",
+	[20] = "MapRequest",
+	[21] = "ReparentNotify",
+	[22] = "ConfigureNotify",
+	[23] = "ConfigureRequest",
+	[28] = "PropertyNotify",
+	[33] = "ClientMessage"
+};
+
+uint64_t
+stats_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// Bucket b counts values in [2^(b-1), 2^b)
+static uint32_t
+stats_bucket(uint64_t value)
+{
+	uint32_t bucket = 0;
+
+	while (value && bucket < STATS_BUCKETS - 1)
+	{
+		value >>= 1;
+		++bucket;
+	}
+
+	return bucket;
+}
+
+void
+stats_event_end(const uint64_t start)
+{
+	if (!stats.enabled)
+	{
+		return;
+	}
+
+	const uint64_t ns = stats_now() - start;
+
+	++stats.events[stats.type];
+	stats.event_ns[stats.type] += ns;
+	++stats.latency[stats.type][stats_bucket(ns / 1000)];
+	stats.type = 0;
+}
+
+void
+stats_wakeup(const uint32_t depth)
+{
+	if (!stats.enabled)
+	{
+		return;
+	}
+
+	++stats.wakeups;
+	++stats.depth[stats_bucket(depth)];
+
+	if (depth > stats.depth_max)
+	{
+		stats.depth_max = depth;
+	}
+}
+
+static void
+stats_histogram(FILE *out, const uint64_t *buckets, const char *unit)
+{
+	for (uint32_t b = 0; b < STATS_BUCKETS; ++b)
+	{
+		if (buckets[b])
+		{
+			fprintf(out, " <%llu%s:%llu",
+					1ull << b, unit,
+					(unsigned long long) buckets[b]);
+		}
+	}
+
+	fprintf(out, "\n");
+}
+
+void
+stats_dump(FILE *out)
+{
+	if (!stats.enabled)
+	{
+		fprintf(out, "stats disabled (set MARTWM_STATS=1)\n");
+		return;
+	}
+
+	fprintf(out, "wakeups %llu flushes %llu replies %llu depth_max %llu\n",
+			(unsigned long long) stats.wakeups,
+			(unsigned long long) stats.flushes,
+			(unsigned long long) stats.replies,
+			(unsigned long long) stats.depth_max);
+
+	fprintf(out, "depth");
+	stats_histogram(out, stats.depth, "");
+
+	for (uint32_t type = 0; type < STATS_TYPES; ++type)
+	{
+		if (!stats.events[type] && !stats.event_replies[type])
+		{
+			continue;
+		}
+
+		const char *name = (type < sizeof(event_names) / sizeof(event_names[0]) &&
+				event_names[type]) ? event_names[type] : "other";
+
+		fprintf(out, "event %u %s count %llu replies %llu avg_us %.1f",
+				type, name,
+				(unsigned long long) stats.events[type],
+				(unsigned long long) stats.event_replies[type],
+				(stats.events[type]) ?
+					stats.event_ns[type] / 1000.0 / stats.events[type] : 0.0);
+		stats_histogram(out, stats.latency[type], "us");
+	}
+
+	fflush(out);
+}
@@ -0,0 +1,78 @@
+#ifndef MARTWM_STATS_H
+#define MARTWM_STATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define STATS_TYPES 128
+#define STATS_BUCKETS 24
+
+/*
+ * Optional instrumentation: handler latency per event type, blocking
+ * replies and flushes, and the number of events handled per wakeup.
+ * Everything is behind a single flag, so a disabled build pays one
+ * predictable branch per hook.
+ */
+typedef struct {
+	bool		enabled;
+	uint8_t		type;
+
+	uint64_t	wakeups;
+	uint64_t	flushes;
+	uint64_t	replies;
+	uint64_t	depth[STATS_BUCKETS];
+	uint64_t	depth_max;
+
+	uint64_t	events[STATS_TYPES];
+	uint64_t	event_replies[STATS_TYPES];
+	uint64_t	event_ns[STATS_TYPES];
+	uint64_t	latency[STATS_TYPES][STATS_BUCKETS];
+} wm_stats_t;
+
+extern wm_stats_t stats;
+
+uint64_t stats_now(void);
+void stats_event_end(const uint64_t start);
+void stats_wakeup(const uint32_t depth);
+void stats_dump(FILE *out);
+
+static inline void
+stats_reply(void)
+{
+	if (stats.enabled)
+	{
+		++stats.replies;
+		++stats.event_replies[stats.type];
+	}
+}
+
+/*
+ * Wraps a *_reply() call, counting it against the event being handled:
+ * reply = STATS_REPLY(xcb_get_geometry_reply(...));
+ */
+#define STATS_REPLY(reply) (stats_reply(), (reply))
+
+static inline void
+stats_flush(void)
+{
+	if (stats.enabled)
+	{
+		++stats.flushes;
+	}
+}
+
+static inline uint64_t
+stats_event_begin(const uint8_t type)
+{
+	if (!stats.enabled)
+	{
+		return 0;
+	}
+
+	stats.type = type;
+
+	return stats_now();
+}
+
+#endif
@@ -0,0 +1,249 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <sys/types.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "status.h"
+
+static const struct {
+	const char	*path;
+	uint32_t	interval_ms;
+} modules[STATUS_ALL] = {
+	[STATUS_CPU] =		{ "/proc/stat",		2000 },
+	[STATUS_LOAD] =		{ "/proc/loadavg",	5000 },
+	[STATUS_MEM] =		{ "/proc/meminfo",	5000 },
+	// Ticks on the minute, see status_timer()
+	[STATUS_CLOCK] =	{ NULL,			60000 }
+};
+
+/*
+ * Read the start of the module's file into buf as a string. /proc files
+ * are generated on each read, so reading from offset 0 gets fresh values.
+ */
+static bool
+status_read(const wm_status_t *status, char *buf, const size_t size)
+{
+	const ssize_t got = pread(status->fd, buf, size - 1, 0);
+
+	if (got <= 0)
+	{
+		return false;
+	}
+
+	buf[got] = '\0';
+
+	return true;
+}
+
+static void
+status_cpu(wm_status_t *status, char *text, const size_t size)
+{
+	char buf[256];
+	uint64_t fields[8] = { 0 };
+
+	if (!status_read(status, buf, sizeof(buf)))
+	{
+		return;
+	}
+
+	// cpu user nice system idle iowait irq softirq steal
+	char *p = buf + 3;
+	uint64_t total = 0;
+
+	for (uint32_t i = 0; i < 8; ++i)
+	{
+		fields[i] = strtoull(p, &p, 10);
+		total += fields[i];
+	}
+
+	const uint64_t idle = fields[3] + fields[4];
+
+	if (status->total && total > status->total)
+	{
+		const uint64_t busy = (total - status->total) - (idle - status->idle);
+
+		snprintf(text, size, "cpu %2llu%%",
+				(unsigned long long) (busy * 100 / (total - status->total)));
+	}
+
+	status->idle = idle;
+	status->total = total;
+}
+
+static void
+status_load(wm_status_t *status, char *text, const size_t size)
+{
+	char buf[64];
+
+	if (status_read(status, buf, sizeof(buf)))
+	{
+		// The 1-minute average, cut to what the module text holds
+		const int len = strcspn(buf, " ");
+
+		snprintf(text, size, "load %.*s", (len < 8) ? len : 8, buf);
+	}
+}
+
+static void
+status_mem(wm_status_t *status, char *text, const size_t size)
+{
+	char buf[512];
+
+	if (!status_read(status, buf, sizeof(buf)))
+	{
+		return;
+	}
+
+	const char *total = strstr(buf, "MemTotal:");
+	const char *available = strstr(buf, "MemAvailable:");
+
+	if (!total || !available)
+	{
+		return;
+	}
+
+	const uint64_t total_kb = strtoull(total + 9, NULL, 10);
+	const uint64_t available_kb = strtoull(available + 13, NULL, 10);
+
+	if (total_kb)
+	{
+		snprintf(text, size, "mem %2llu%%",
+				(unsigned long long) ((total_kb - available_kb) * 100 / total_kb));
+	}
+}
+
+static void
+status_clock(char *text, const size_t size)
+{
+	const time_t now = time(NULL);
+	struct tm local;
+
+	if (localtime_r(&now, &local))
+	{
+		strftime(text, size, "%H:%M", &local);
+	}
+}
+
+/*
+ * Arm the module's timer. The clock fires at the next wall-clock minute
+ * and then every minute, the others at their interval.
+ */
+static bool
+status_timer(wm_status_t *status)
+{
+	const uint32_t interval = modules[status->kind].interval_ms;
+	struct itimerspec spec = {
+		.it_interval = { interval / 1000, (interval % 1000) * 1000000 },
+		.it_value = { interval / 1000, (interval % 1000) * 1000000 }
+	};
+	int flags = 0;
+
+	if (status->kind == STATUS_CLOCK)
+	{
+		status->timer = timerfd_create(CLOCK_REALTIME, TFD_NONBLOCK | TFD_CLOEXEC);
+
+		spec.it_value.tv_sec = (time(NULL) / 60 + 1) * 60;
+		spec.it_value.tv_nsec = 0;
+		flags = TFD_TIMER_ABSTIME;
+	}
+	else
+	{
+		status->timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	}
+
+	return status->timer != -1 && timerfd_settime(status->timer, flags, &spec, NULL) != -1;
+}
+
+bool
+status_open(wm_status_t *status, const uint32_t kind)
+{
+	memset(status, 0, sizeof(wm_status_t));
+	status->kind = kind;
+	status->fd = -1;
+	status->timer = -1;
+
+	if (modules[kind].path)
+	{
+		status->fd = open(modules[kind].path, O_RDONLY | O_CLOEXEC);
+
+		if (status->fd == -1)
+		{
+			return false;
+		}
+	}
+
+	if (!status_timer(status))
+	{
+		status_close(status);
+		return false;
+	}
+
+	status_update(status);
+
+	return true;
+}
+
+void
+status_close(wm_status_t *status)
+{
+	if (status->fd != -1)
+	{
+		close(status->fd);
+		status->fd = -1;
+	}
+
+	if (status->timer != -1)
+	{
+		close(status->timer);
+		status->timer = -1;
+	}
+
+	status->text[0] = '\0';
+}
+
+/*
+ * Acknowledge the timer and refresh the text. Returns whether the text
+ * changed, the bar only needs a redraw then.
+ */
+bool
+status_update(wm_status_t *status)
+{
+	uint64_t expirations;
+	char text[sizeof(status->text)];
+
+	while (read(status->timer, &expirations, sizeof(expirations)) > 0);
+
+	snprintf(text, sizeof(text), "%s", status->text);
+
+	switch (status->kind)
+	{
+	case STATUS_CPU:
+		status_cpu(status, text, sizeof(text));
+		break;
+	case STATUS_LOAD:
+		status_load(status, text, sizeof(text));
+		break;
+	case STATUS_MEM:
+		status_mem(status, text, sizeof(text));
+		break;
+	case STATUS_CLOCK:
+		status_clock(text, sizeof(text));
+		break;
+	}
+
+	if (strcmp(text, status->text) == 0)
+	{
+		return false;
+	}
+
+	memcpy(status->text, text, sizeof(text));
+
+	return true;
+}
@@ -0,0 +1,36 @@
+#ifndef MARTWM_STATUS_H
+#define MARTWM_STATUS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+enum {
+	STATUS_CPU,
+	STATUS_LOAD,
+	STATUS_MEM,
+	STATUS_CLOCK,
+	STATUS_ALL
+};
+
+/*
+ * A bar status module. Each one ticks on its own timerfd and re-reads a
+ * /proc file opened once at startup with pread(), so a tick costs a few
+ * syscalls and no process. Modules whose file or timer is unavailable
+ * stay empty.
+ */
+typedef struct {
+	uint32_t	kind;
+	int		timer;
+	int		fd;
+	char		text[24];
+
+	// Previous /proc/stat sample, the CPU module shows the difference
+	uint64_t	idle;
+	uint64_t	total;
+} wm_status_t;
+
+bool status_open(wm_status_t *status, const uint32_t kind);
+void status_close(wm_status_t *status);
+bool status_update(wm_status_t *status);
+
+#endif
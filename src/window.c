@@ -0,0 +1,170 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "window.h"
+
+bool
+table_init(wm_table_t *table, const uint32_t cap)
+{
+	memset(table, 0, sizeof(wm_table_t));
+	table->free = -1;
+	table->windows = calloc(cap, sizeof(wm_window_t));
+
+	if (!table->windows || !hash_init(&table->index, cap * 2))
+	{
+		table_free(table);
+		return false;
+	}
+
+	table->cap = cap;
+
+	return true;
+}
+
+void
+table_free(wm_table_t *table)
+{
+	free(table->windows);
+	hash_free(&table->index);
+	table->windows = NULL;
+	table->len = 0;
+	table->cap = 0;
+	table->count = 0;
+	table->free = -1;
+}
+
+static int32_t
+table_slot(wm_table_t *table)
+{
+	if (table->free != -1)
+	{
+		const int32_t index = table->free;
+		table->free = table->windows[index].next_free;
+
+		return index;
+	}
+
+	if (table->len == table->cap)
+	{
+		const uint32_t cap = (table->cap) ? table->cap * 2 : 64;
+		wm_window_t *grown = realloc(table->windows, cap * sizeof(wm_window_t));
+
+		if (!grown)
+		{
+			fprintf(stderr, "ERROR: Cannot grow window table to %u.\n", cap);
+			return -1;
+		}
+
+		memset(&grown[table->cap], 0, (cap - table->cap) * sizeof(wm_window_t));
+		table->windows = grown;
+		table->cap = cap;
+	}
+
+	return table->len++;
+}
+
+/*
+ * Claim a slot for a new window and index it under both its client and
+ * its frame id. Returns the slot, zeroed apart from the ids, or -1.
+ */
+int32_t
+table_add(wm_table_t *table, const xcb_window_t id, const xcb_window_t frame)
+{
+	const int32_t index = table_slot(table);
+	if (index == -1)
+	{
+		return -1;
+	}
+
+	wm_window_t *window = &table->windows[index];
+	const uint32_t generation = window->generation;
+
+	memset(window, 0, sizeof(wm_window_t));
+	window->id = id;
+	window->frame = frame;
+	window->generation = generation;
+	window->next_free = -1;
+
+	if (!hash_insert(&table->index, id, index) ||
+			!hash_insert(&table->index, frame, index))
+	{
+		hash_remove(&table->index, id);
+		window->id = 0;
+		window->frame = 0;
+		window->next_free = table->free;
+		table->free = index;
+
+		return -1;
+	}
+
+	++table->count;
+
+	return index;
+}
+
+void
+table_remove(wm_table_t *table, const int32_t index)
+{
+	wm_window_t *window = &table->windows[index];
+
+	if (window->id == 0)
+	{
+		return;
+	}
+
+	hash_remove(&table->index, window->id);
+	hash_remove(&table->index, window->frame);
+
+	const uint32_t generation = window->generation + 1;
+
+	memset(window, 0, sizeof(wm_window_t));
+	window->generation = generation;
+	window->next_free = table->free;
+	table->free = index;
+
+	--table->count;
+}
+
+int32_t
+table_find(const wm_table_t *table, const xcb_window_t id)
+{
+	const int32_t index = hash_find(&table->index, id);
+
+	return (index != -1 && table->windows[index].id == id) ? index : -1;
+}
+
+int32_t
+table_find_frame(const wm_table_t *table, const xcb_window_t frame)
+{
+	const int32_t index = hash_find(&table->index, frame);
+
+	return (index != -1 && table->windows[index].frame == frame) ? index : -1;
+}
+
+wm_handle_t
+table_handle(const wm_table_t *table, const int32_t index)
+{
+	return (wm_handle_t) {
+		.slot = index,
+		.generation = table->windows[index].generation
+	};
+}
+
+int32_t
+table_resolve(const wm_table_t *table, const wm_handle_t handle)
+{
+	if (handle.slot >= table->len)
+	{
+		return -1;
+	}
+
+	const wm_window_t *window = &table->windows[handle.slot];
+
+	if (window->id == 0 || window->generation != handle.generation)
+	{
+		return -1;
+	}
+
+	return handle.slot;
+}
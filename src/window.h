@@ -0,0 +1,111 @@
+#ifndef MARTWM_WINDOW_H
+#define MARTWM_WINDOW_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <xcb/xcb.h>
+
+#include "hash.h"
+
+enum {
+	WM_PROTOCOL_DELETE	= 1 << 0,
+	WM_PROTOCOL_TAKE_FOCUS	= 1 << 1,
+	WM_PROTOCOL_SYNC_REQUEST	= 1 << 2
+};
+
+typedef struct {
+	xcb_window_t	frame;
+	xcb_window_t 	id;
+	char		name[64];
+	bool		visible;
+
+	// UnmapNotify events the WM caused itself, see adopt_finish()
+	uint32_t	ignore_unmaps;
+
+	// Cached frame state, as last set by the WM or reported by the server
+	xcb_rectangle_t	rect;
+	uint16_t	border;
+	uint32_t	stack;
+
+	// Adoption order, tiling puts the oldest window in the master area
+	uint32_t	order;
+
+	// _NET_WM_STATE_FULLSCREEN, with the frame geometry to go back to
+	bool		fullscreen;
+	xcb_rectangle_t	restore;
+	uint16_t	restore_border;
+
+	// Workspace membership, a list linked through the members of each
+	// workspace; visible is false while the workspace is not shown
+	uint32_t	monitor;
+	uint32_t	workspace;
+	int32_t		workspace_prev;
+	int32_t		workspace_next;
+
+	// Pre-rendered title strips, unfocused and focused, see frame_decor_render()
+	xcb_pixmap_t	decor[2];
+	uint16_t	decor_width;
+
+	// Client properties, read once when the window is adopted
+	char		instance[32];
+	char		class[32];
+	xcb_window_t	transient_for;
+	uint32_t	protocols;
+	uint16_t	min_width;
+	uint16_t	min_height;
+	uint16_t	max_width;
+	uint16_t	max_height;
+	bool		input;
+
+	// _NET_WM_SYNC_REQUEST state, only used while resizing
+	uint32_t	sync_counter;
+	uint32_t	sync_alarm;
+	uint64_t	sync_value;
+	uint64_t	sync_sent;
+	bool		sync_waiting;
+
+	// _NET_WM_NAME and WM_NAME requests sent after a name change, read
+	// once the event batch is drained, see title_collect()
+	xcb_get_property_cookie_t	title_cookies[2];
+	bool		title_pending;
+
+	// Slot bookkeeping, owned by the table
+	uint32_t	generation;
+	int32_t		next_free;
+} wm_window_t;
+
+/*
+ * A reference to a table slot that goes stale once the window in it is
+ * removed: the slot's generation is bumped on every removal, so resolving
+ * an old handle fails even after the slot has been reused.
+ */
+typedef struct {
+	uint32_t	slot;
+	uint32_t	generation;
+} wm_handle_t;
+
+/*
+ * Managed windows. Removed slots go onto a free list and are reused before
+ * the table grows, so its size follows the peak number of live windows
+ * rather than the number ever mapped. A slot with id 0 is free.
+ */
+typedef struct {
+	wm_window_t	*windows;
+	uint32_t	len;
+	uint32_t	cap;
+	uint32_t	count;
+	int32_t		free;
+	wm_hash_t	index;
+} wm_table_t;
+
+bool table_init(wm_table_t *table, const uint32_t cap);
+void table_free(wm_table_t *table);
+int32_t table_add(wm_table_t *table, const xcb_window_t id, const xcb_window_t frame);
+void table_remove(wm_table_t *table, const int32_t index);
+int32_t table_find(const wm_table_t *table, const xcb_window_t id);
+int32_t table_find_frame(const wm_table_t *table, const xcb_window_t frame);
+wm_handle_t table_handle(const wm_table_t *table, const int32_t index);
+int32_t table_resolve(const wm_table_t *table, const wm_handle_t handle);
+
+#endif